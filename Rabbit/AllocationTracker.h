@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+// Opt-in heap allocation counting for the render loop. Build with TRACK_ALLOCATIONS to make
+// main.cpp replace the global operator new; add ALLOCATION_BUDGET=<n> (e.g. 0 in test builds)
+// to abort when a steady-state frame allocates more than n times.
+#ifdef TRACK_ALLOCATIONS
+#define ALLOCATION_SITE(name) AllocationSite allocationSite(name)
+#else
+#define ALLOCATION_SITE(name)
+#endif
+
+const int ALLOCATION_SITES = 32;
+// the first frames still grow the draw lists, uniform rings and uniform caches
+const unsigned int ALLOCATION_WARMUP_FRAMES = 3;
+
+// Allocations and bytes per frame, attributed to the innermost AllocationSite of the
+// allocating thread; allocations outside any site count as "untracked".
+class AllocationTracker {
+public:
+	// constant-initialized, so operator new can use it before any constructor runs
+	static AllocationTracker & Get() {
+		static AllocationTracker tracker;
+		return tracker;
+	}
+
+	void Record(size_t bytes) {
+		if (this->reporting.load(std::memory_order_relaxed))
+			return;
+		int site = CurrentSite();
+		this->count[site].fetch_add(1, std::memory_order_relaxed);
+		this->bytes[site].fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	// Site index for name, added on first use; names are compared by pointer
+	int Site(const char * name) {
+		for (int i = 1; i < this->sites; ++i)
+			if (this->names[i] == name)
+				return i;
+		if (this->sites == ALLOCATION_SITES)
+			return 0;
+		this->names[this->sites] = name;
+		return this->sites++;
+	}
+
+	// Innermost site of the calling thread
+	static int & CurrentSite() {
+		static thread_local int site = 0;
+		return site;
+	}
+
+	// Closes the frame: keeps its counts for Report and checks the budget once warmed up
+	void EndFrame() {
+		size_t total = 0;
+		for (int i = 0; i < this->sites; ++i) {
+			this->lastCount[i] = this->count[i].exchange(0, std::memory_order_relaxed);
+			this->lastBytes[i] = this->bytes[i].exchange(0, std::memory_order_relaxed);
+			total += this->lastCount[i];
+		}
+		++this->frame;
+		if (this->frame <= ALLOCATION_WARMUP_FRAMES || total == 0)
+			return;
+#ifdef ALLOCATION_BUDGET
+		if (total > (size_t)(ALLOCATION_BUDGET)) {
+			std::cout << "ERROR::ALLOCATION::BUDGET_EXCEEDED " << total << " > " << (ALLOCATION_BUDGET) << std::endl;
+			this->Report();
+			abort();
+		}
+#endif
+		if (!this->warned) {
+			this->warned = true;
+			std::cout << "WARNING::ALLOCATION::STEADY_STATE_FRAME_ALLOCATES" << std::endl;
+			this->Report();
+		}
+	}
+
+	// Prints the last closed frame per site
+	void Report() {
+		// printing may allocate; keep it out of the counts
+		this->reporting = true;
+		std::cout << "ALLOCATION::FRAME " << this->frame << std::endl;
+		for (int i = 0; i < this->sites; ++i)
+			if (this->lastCount[i] > 0)
+				std::cout << "  " << this->names[i] << ": " << this->lastCount[i] << " allocations, "
+					<< this->lastBytes[i] << " bytes" << std::endl;
+		this->reporting = false;
+	}
+
+private:
+	std::atomic<size_t> count[ALLOCATION_SITES];
+	std::atomic<size_t> bytes[ALLOCATION_SITES];
+	size_t lastCount[ALLOCATION_SITES];
+	size_t lastBytes[ALLOCATION_SITES];
+	const char * names[ALLOCATION_SITES] = { "untracked" };
+	int sites = 1;
+	unsigned int frame = 0;
+	bool warned = false;
+	std::atomic<bool> reporting;
+
+	constexpr AllocationTracker() : count(), bytes(), lastCount(), lastBytes(), reporting(false) {}
+};
+
+// Attributes the allocations of its lifetime on this thread to name, a string literal
+class AllocationSite {
+public:
+	AllocationSite(const char * name) {
+		this->previous = AllocationTracker::CurrentSite();
+		AllocationTracker::CurrentSite() = AllocationTracker::Get().Site(name);
+	}
+	~AllocationSite() {
+		AllocationTracker::CurrentSite() = this->previous;
+	}
+	AllocationSite(const AllocationSite &) = delete;
+	AllocationSite & operator=(const AllocationSite &) = delete;
+
+private:
+	int previous;
+};
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "VertexLayout.h"
+#include "Model.h"
+
+// Varyings captured from GraftalsRabbit.geom, in buffer order
+const std::vector<const GLchar*> GRAFTAL_FEEDBACK_VARYINGS = {
+	"fFragPosition", "fNormal", "fTexCoords", "fTipPosition", "fTipNormal"
+};
+
+struct FeedbackVertex {
+	glm::vec3 FragPosition;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+	glm::vec3 TipPosition;
+	glm::vec3 TipNormal;
+};
+
+typedef VertexLayout<FeedbackVertex,
+	VertexAttribute<0, VERTEX_MEMBER(FeedbackVertex, FragPosition)>,
+	VertexAttribute<1, VERTEX_MEMBER(FeedbackVertex, Normal)>,
+	VertexAttribute<2, VERTEX_MEMBER(FeedbackVertex, TexCoords)>,
+	VertexAttribute<3, VERTEX_MEMBER(FeedbackVertex, TipPosition)>,
+	VertexAttribute<4, VERTEX_MEMBER(FeedbackVertex, TipNormal)>> FeedbackVertexLayout;
+
+// Records the view-independent output of the GraftalBunny geometry shader once with
+// transform feedback and replays it until displacement, model or furLength change.
+// Every input triangle emits exactly three fins in capture mode, so the vertex count is known.
+class FeedbackCache {
+public:
+	FeedbackCache(Model & source) {
+		this->source = &source;
+		GLsizei triangles = 0;
+		for (const auto & mesh : source.meshes)
+			triangles += mesh.TriangleCount();
+		this->vertexCount = triangles * 9;
+		if (!source.meshes.empty())
+			this->textures = source.meshes[0].textures;
+
+		this->VAO.Create(GPU_OTHER);
+		this->VBO.Create(GPU_VERTEX);
+		RenderState::Get().BindVertexArray(this->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)this->vertexCount * sizeof(FeedbackVertex), NULL, GL_DYNAMIC_COPY);
+		this->VBO.SetBytes((GLsizeiptr)this->vertexCount * sizeof(FeedbackVertex));
+		FeedbackVertexLayout::Setup();
+
+		RenderState::Get().BindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Returns true when the cached output is stale; the next Draw then captures instead of replaying
+	bool Update(glm::vec3 disp, glm::mat4 model, float furLength) {
+		if (this->valid && disp == this->disp && model == this->model && furLength == this->furLength)
+			return false;
+		this->disp = disp;
+		this->model = model;
+		this->furLength = furLength;
+		this->capturing = true;
+		return true;
+	}
+
+	void Draw(Shader & shader) {
+		if (this->capturing) {
+			glEnable(GL_RASTERIZER_DISCARD);
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, this->VBO);
+			glBeginTransformFeedback(GL_TRIANGLES);
+			this->source->Draw(shader);
+			glEndTransformFeedback();
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+			glDisable(GL_RASTERIZER_DISCARD);
+			this->capturing = false;
+			this->valid = true;
+			return;
+		}
+
+		this->material.Bind(shader, this->textures);
+		RenderState::Get().BindVertexArray(this->VAO);
+		glDrawArrays(GL_TRIANGLES, 0, this->vertexCount);
+	}
+
+private:
+	Model * source;
+	vector<Texture> textures;
+	MaterialBindings material;
+	VertexArrayHandle VAO;
+	BufferHandle VBO;
+	GLsizei vertexCount;
+	bool valid = false;
+	bool capturing = false;
+	glm::vec3 disp;
+	glm::mat4 model;
+	float furLength;
+};
\ No newline at end of file
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <iostream>
+#include <GL/glew.h>
+#include "RenderState.h"
+
+// What a GL object's storage is counted as
+enum GpuCategory {
+	GPU_VERTEX = 0,
+	GPU_INDEX,
+	GPU_TEXTURE,
+	GPU_FUR,
+	GPU_UNIFORM,
+	GPU_OTHER,
+	GPU_CATEGORIES
+};
+
+const char * const GPU_CATEGORY_NAMES[GPU_CATEGORIES] = {
+	"vertex", "index", "texture", "fur", "uniform", "other"
+};
+
+// Bytes and objects held by live handles per category
+class GpuRegistry {
+public:
+	// never destroyed, so handles in static storage can still release into it at exit
+	static GpuRegistry & Get() {
+		static GpuRegistry * registry = new GpuRegistry();
+		return *registry;
+	}
+
+	void Add(GpuCategory category, GLsizeiptr bytes, int objects = 0) {
+		this->bytes[category] += bytes;
+		this->objects[category] += objects;
+	}
+
+	GLsizeiptr Bytes(GpuCategory category) const {
+		return this->bytes[category];
+	}
+
+	GLsizeiptr Total() const {
+		GLsizeiptr total = 0;
+		for (int i = 0; i < GPU_CATEGORIES; ++i)
+			total += this->bytes[i];
+		return total;
+	}
+
+	// Called before the context goes away; handles released afterwards only update the counts
+	void Shutdown() {
+		this->alive = false;
+	}
+
+	bool Alive() const {
+		return this->alive;
+	}
+
+	void Report() const {
+		std::cout << "GPU::MEMORY" << std::endl;
+		for (int i = 0; i < GPU_CATEGORIES; ++i)
+			std::cout << "  " << GPU_CATEGORY_NAMES[i] << ": " << this->objects[i] << " objects, "
+				<< this->bytes[i] / 1024 << " KB" << std::endl;
+		std::cout << "  total: " << this->Total() / 1024 << " KB" << std::endl;
+	}
+
+private:
+	GLsizeiptr bytes[GPU_CATEGORIES] = {};
+	int objects[GPU_CATEGORIES] = {};
+	bool alive = true;
+
+	GpuRegistry() {}
+};
+
+struct BufferTraits {
+	static GLuint Create() {
+		GLuint id;
+		glGenBuffers(1, &id);
+		return id;
+	}
+	static void Destroy(GLuint id) {
+		glDeleteBuffers(1, &id);
+	}
+};
+
+struct VertexArrayTraits {
+	static GLuint Create() {
+		GLuint id;
+		glGenVertexArrays(1, &id);
+		return id;
+	}
+	static void Destroy(GLuint id) {
+		RenderState::Get().ForgetVertexArray(id);
+		glDeleteVertexArrays(1, &id);
+	}
+};
+
+struct TextureTraits {
+	static GLuint Create() {
+		GLuint id;
+		glGenTextures(1, &id);
+		return id;
+	}
+	static void Destroy(GLuint id) {
+		RenderState::Get().ForgetTexture(id);
+		glDeleteTextures(1, &id);
+	}
+};
+
+struct ProgramTraits {
+	static GLuint Create() {
+		return glCreateProgram();
+	}
+	static void Destroy(GLuint id) {
+		RenderState::Get().ForgetProgram(id);
+		glDeleteProgram(id);
+	}
+};
+
+struct FramebufferTraits {
+	static GLuint Create() {
+		GLuint id;
+		glGenFramebuffers(1, &id);
+		return id;
+	}
+	static void Destroy(GLuint id) {
+		glDeleteFramebuffers(1, &id);
+	}
+};
+
+// Move-only owner of one GL object. The storage size given to SetBytes is counted in the
+// registry under the handle's category until the object is released.
+template<class Traits>
+class GLHandle {
+public:
+	GLHandle() {}
+	GLHandle(GLHandle && other) {
+		this->take(other);
+	}
+	GLHandle & operator=(GLHandle && other) {
+		if (this != &other) {
+			this->Reset();
+			this->take(other);
+		}
+		return *this;
+	}
+	GLHandle(const GLHandle &) = delete;
+	GLHandle & operator=(const GLHandle &) = delete;
+	~GLHandle() {
+		this->Reset();
+	}
+
+	// Releases any current object and creates a new one
+	void Create(GpuCategory category) {
+		this->Reset();
+		this->id = Traits::Create();
+		this->category = category;
+		GpuRegistry::Get().Add(category, 0, 1);
+	}
+
+	void Reset() {
+		if (this->id == 0)
+			return;
+		GpuRegistry::Get().Add(this->category, -this->bytes, -1);
+		if (GpuRegistry::Get().Alive())
+			Traits::Destroy(this->id);
+		this->id = 0;
+		this->bytes = 0;
+	}
+
+	// Records the size of the storage just allocated for the object
+	void SetBytes(GLsizeiptr bytes) {
+		GpuRegistry::Get().Add(this->category, bytes - this->bytes);
+		this->bytes = bytes;
+	}
+
+	GLsizeiptr Bytes() const {
+		return this->bytes;
+	}
+
+	operator GLuint() const {
+		return this->id;
+	}
+
+private:
+	GLuint id = 0;
+	GpuCategory category = GPU_OTHER;
+	GLsizeiptr bytes = 0;
+
+	void take(GLHandle & other) {
+		this->id = other.id;
+		this->category = other.category;
+		this->bytes = other.bytes;
+		other.id = 0;
+		other.bytes = 0;
+	}
+};
+
+typedef GLHandle<BufferTraits> BufferHandle;
+typedef GLHandle<VertexArrayTraits> VertexArrayHandle;
+typedef GLHandle<TextureTraits> TextureHandle;
+typedef GLHandle<ProgramTraits> ProgramHandle;
+typedef GLHandle<FramebufferTraits> FramebufferHandle;
\ No newline at end of file
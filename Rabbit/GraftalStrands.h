@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <GL/glew.h>
+#include "Shader.h"
+#include "Model.h"
+
+static_assert(sizeof(GraftalVertex) == 10 * sizeof(GLfloat), "VertexFurRabbit.vert reads 10 floats per GraftalVertex");
+
+// VertexBunny strands: one instanced line strip per welded vertex of a GraftalModel.
+// VertexFurRabbit.vert pulls the vertex from a buffer texture over the graftal VBO by
+// gl_InstanceID, so shared vertices grow a single strand.
+class GraftalStrands {
+public:
+	GraftalStrands(GraftalModel & graftals, int layers) {
+		this->graftals = &graftals;
+		this->layers = layers;
+		// a view of the graftal VBO, which already counts the storage
+		this->bufferTexture.Create(GPU_OTHER);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_BUFFER, this->bufferTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, graftals.VBO);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_BUFFER, 0);
+	}
+
+	void Draw(Shader & shader) {
+		const vector<Texture> & textures = this->graftals->textures;
+		this->material.Bind(shader, textures);
+		// samplers that are never set point at unit 0, which must not hold the buffer texture
+		int idx = glm::max((int)textures.size(), 1);
+		RenderState::Get().BindTexture(idx, GL_TEXTURE_BUFFER, this->bufferTexture);
+		shader.SetInt("graftals", idx);
+		shader.SetInt("strandLayers", this->layers);
+
+		// the VAO is only bound because core profile requires one; attributes are unused
+		RenderState::Get().BindVertexArray(this->graftals->VAO);
+		glDrawArraysInstanced(GL_LINE_STRIP, 0, this->layers, (GLsizei)this->graftals->VertexCount());
+	}
+
+private:
+	GraftalModel * graftals;
+	int layers;
+	TextureHandle bufferTexture;
+	MaterialBindings material;
+};
\ No newline at end of file
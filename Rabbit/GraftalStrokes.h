@@ -0,0 +1,110 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "Shader.h"
+#include "VertexLayout.h"
+#include "Model.h"
+
+// Samples along each side of a stroke; main.cpp passes these to ArtRabbit.comp and ArtRabbit.geom
+#define STROKE_LAYERS 10
+// (STROKE_LAYERS * 2 - 3) triangles and (STROKE_LAYERS * 2 - 2) line segments per stroke
+#define STROKE_FILL_VERTICES ((STROKE_LAYERS * 2 - 3) * 3)
+#define STROKE_OUTLINE_VERTICES ((STROKE_LAYERS * 2 - 2) * 2)
+// fill strip and outline strip of the geometry shader path
+#define STROKE_GEOMETRY_VERTICES (STROKE_LAYERS * 2 + (STROKE_LAYERS * 2 - 1) * 2)
+#define STROKE_LOCAL_SIZE 64
+
+struct DrawArraysIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+// GL 4.3 path for the ArtBunny strokes: ArtRabbit.comp expands the graftal points into
+// world-space stroke vertices and bumps the indirect draw counts, so no geometry shader runs.
+// Every stroke vertex is a vec4: xyz position, w < 0 for fill, alpha (+2 for lodLevel 2) for outline.
+typedef VertexLayout<glm::vec4, VertexAttribute<0, glm::vec4, 0>> StrokeVertexLayout;
+
+class GraftalStrokes {
+public:
+	// capacity: fraction of the points that may turn into a stroke in one frame
+	GraftalStrokes(GraftalModel & graftals, float capacity = 0.5f) {
+		this->graftals = &graftals;
+		this->maxStrokes = (GLuint)ceil(graftals.VertexCount() * capacity);
+
+		this->commandBuffer.Create(GPU_OTHER);
+		this->counterBuffer.Create(GPU_OTHER);
+
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, this->counterBuffer);
+		glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+		this->counterBuffer.SetBytes(sizeof(GLuint));
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, 2 * sizeof(DrawArraysIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+		this->commandBuffer.SetBytes(2 * sizeof(DrawArraysIndirectCommand));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		setupVAO(this->fillVAO, this->fillVBO, (GLsizeiptr)maxStrokes * STROKE_FILL_VERTICES * sizeof(glm::vec4));
+		setupVAO(this->outlineVAO, this->outlineVBO, (GLsizeiptr)maxStrokes * STROKE_OUTLINE_VERTICES * sizeof(glm::vec4));
+	}
+
+	void Generate(Shader & shader, glm::mat4 model, glm::vec3 viewPos, glm::vec3 disp) {
+		const DrawArraysIndirectCommand reset[2] = { { 0, 1, 0, 0 }, { 0, 1, 0, 0 } };
+		const GLuint zero = 0;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(reset), reset);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, this->counterBuffer);
+		glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+		GLuint pointCount = (GLuint)this->graftals->VertexCount();
+		shader.Use();
+		shader.SetMat4("model", model);
+		shader.SetVec3("viewPos", viewPos);
+		shader.SetVec3("displacement", disp);
+		shader.SetUint("pointCount", pointCount);
+		shader.SetUint("maxStrokes", this->maxStrokes);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->graftals->VBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->fillVBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->outlineVBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->commandBuffer);
+		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, this->counterBuffer);
+		glDispatchCompute((pointCount + STROKE_LOCAL_SIZE - 1) / STROKE_LOCAL_SIZE, 1, 1);
+		// the draws read the commands and strokes; the next Generate resets commands and counter with glBufferSubData
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	}
+
+	void Draw(Shader & shader) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+		RenderState::Get().BindVertexArray(this->fillVAO);
+		glDrawArraysIndirect(GL_TRIANGLES, (GLvoid*)0);
+		RenderState::Get().BindVertexArray(this->outlineVAO);
+		glDrawArraysIndirect(GL_LINES, (GLvoid*)sizeof(DrawArraysIndirectCommand));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+private:
+	GraftalModel * graftals;
+	GLuint maxStrokes;
+	VertexArrayHandle fillVAO, outlineVAO;
+	BufferHandle fillVBO, outlineVBO;
+	BufferHandle commandBuffer;
+	BufferHandle counterBuffer;
+
+	void setupVAO(VertexArrayHandle & vao, BufferHandle & vbo, GLsizeiptr size) {
+		vao.Create(GPU_OTHER);
+		vbo.Create(GPU_VERTEX);
+		RenderState::Get().BindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+		vbo.SetBytes(size);
+		StrokeVertexLayout::Setup();
+		RenderState::Get().BindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
\ No newline at end of file
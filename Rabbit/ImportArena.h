@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Linear allocator for the temporaries of model imports, reset in one go when the outermost
+// ImportScope ends. Only the first regular block outlives the reset, so the peak of an import
+// does not stay resident once loading is done.
+// Only the loading thread allocates from it; workers write into buffers sized beforehand.
+class ImportArena {
+public:
+	// never destroyed, like GpuRegistry
+	static ImportArena & Get() {
+		static ImportArena * arena = new ImportArena();
+		return *arena;
+	}
+
+	void * Allocate(size_t bytes, size_t align) {
+		while (this->current < this->blocks.size()) {
+			Block & block = this->blocks[this->current];
+			size_t first = (this->offset + align - 1) / align * align;
+			if (first + bytes <= block.size) {
+				this->offset = first + bytes;
+				this->used += bytes;
+				return block.data + first;
+			}
+			++this->current;
+			this->offset = 0;
+		}
+		size_t size = bytes + align > IMPORT_ARENA_BLOCK ? bytes + align : IMPORT_ARENA_BLOCK;
+		Block block{ (char*)malloc(size), size };
+		if (block.data == nullptr)
+			throw std::bad_alloc();
+		this->blocks.push_back(block);
+		this->current = this->blocks.size() - 1;
+		this->offset = 0;
+		return this->Allocate(bytes, align);
+	}
+
+	// Everything allocated since the last reset becomes invalid
+	void Reset() {
+		this->current = 0;
+		this->offset = 0;
+		this->used = 0;
+	}
+
+	// Returns the blocks to the heap, keeping the first one when it has the regular size
+	void Trim() {
+		size_t keep = !this->blocks.empty() && this->blocks[0].size == IMPORT_ARENA_BLOCK ? 1 : 0;
+		for (size_t i = keep; i < this->blocks.size(); ++i)
+			free(this->blocks[i].data);
+		this->blocks.resize(keep);
+		this->blocks.shrink_to_fit();
+		this->Reset();
+	}
+
+	size_t Used() const {
+		return this->used;
+	}
+
+	size_t Capacity() const {
+		size_t capacity = 0;
+		for (const Block & block : this->blocks)
+			capacity += block.size;
+		return capacity;
+	}
+
+private:
+	static const size_t IMPORT_ARENA_BLOCK = 4 << 20;
+	struct Block {
+		char * data;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	size_t current = 0;
+	size_t offset = 0;
+	size_t used = 0;
+
+	ImportArena() {}
+};
+
+// Marks an import; the arena is reset and trimmed when the outermost one ends, so nested loads are fine
+class ImportScope {
+public:
+	ImportScope() {
+		++depth();
+	}
+	~ImportScope() {
+		if (--depth() == 0)
+			ImportArena::Get().Trim();
+	}
+	ImportScope(const ImportScope &) = delete;
+	ImportScope & operator=(const ImportScope &) = delete;
+
+private:
+	static int & depth() {
+		static int d = 0;
+		return d;
+	}
+};
+
+// Allocator for containers that die inside the current ImportScope; freeing is a no-op
+template<class T>
+struct ScratchAllocator {
+	typedef T value_type;
+
+	ScratchAllocator() {}
+	template<class U> ScratchAllocator(const ScratchAllocator<U> &) {}
+
+	T * allocate(size_t n) {
+		return (T*)ImportArena::Get().Allocate(n * sizeof(T), alignof(T));
+	}
+	void deallocate(T *, size_t) {}
+};
+
+template<class T, class U>
+bool operator==(const ScratchAllocator<T> &, const ScratchAllocator<U> &) { return true; }
+template<class T, class U>
+bool operator!=(const ScratchAllocator<T> &, const ScratchAllocator<U> &) { return false; }
+
+template<class T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Model.h"
+#include "UniformBlocks.h"
+
+// Unit the shells read the cache from; material and fur textures take the units below
+const GLuint LIGHTING_CACHE_UNIT = 7;
+const GLsizei LIGHTING_CACHE_MIN_SIZE = 64;
+const GLsizei LIGHTING_CACHE_MAX_SIZE = 1024;
+
+// Lighting of a shell model's base surface, shaded once into the base's UV space by
+// LightingCache.vert/.frag. Shell shaders built with LIGHTING_CACHE 1 read it instead of
+// evaluating every light on each layer. The texture follows the model's size on screen,
+// and only the texels a triangle covers are written, with coverage in alpha.
+// The base's UVs must lie in [0, 1] and must not overlap.
+class LightingCache {
+public:
+	LightingCache(Model & base) {
+		this->base = &base;
+		glm::vec3 lo(0.0f), hi(0.0f);
+		bool first = true;
+		for (const auto & mesh : base.meshes)
+			for (const Vertex & vertex : mesh.vertices) {
+				lo = first ? vertex.Position : glm::min(lo, vertex.Position);
+				hi = first ? vertex.Position : glm::max(hi, vertex.Position);
+				first = false;
+			}
+		this->center = (lo + hi) * 0.5f;
+		this->radius = glm::length(hi - lo) * 0.5f;
+
+		this->FBO.Create(GPU_OTHER);
+		this->texture.Create(GPU_TEXTURE);
+	}
+
+	// Returns true when the cached lighting is stale for this view; the next Draw then reshades it.
+	// Shell displacement is ignored, so animated fur keeps the cache as long as the view holds.
+	bool Update(Shader & shader, const glm::mat4 & model, const CameraBlock & camera, GLuint screenHeight) {
+		GLsizei size = this->resolution(model, camera, screenHeight);
+		if (this->valid && &shader == this->shader && size == this->size && model == this->model && camera.view == this->view)
+			return false;
+		this->shader = &shader;
+		this->model = model;
+		this->view = camera.view;
+		if (size != this->size) {
+			this->size = size;
+			this->allocate();
+		}
+		return true;
+	}
+
+	// Shades the base into the cache; main keeps depth test, culling and blending on between passes
+	void Draw(Shader & shader) {
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+		glViewport(0, 0, this->size, this->size);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_BLEND);
+		this->base->Draw(shader);
+		glEnable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		this->valid = true;
+	}
+
+	// Points the shell shader, which must be in use, at the cache
+	void Bind(Shader & shader) {
+		RenderState::Get().BindTexture(LIGHTING_CACHE_UNIT, GL_TEXTURE_2D, this->texture);
+		shader.SetInt("lightingCache", (GLint)LIGHTING_CACHE_UNIT);
+	}
+
+private:
+	Model * base;
+	glm::vec3 center;
+	float radius;
+	FramebufferHandle FBO;
+	TextureHandle texture;
+	GLsizei size = 0;
+	bool valid = false;
+	Shader * shader = nullptr;
+	glm::mat4 model;
+	glm::mat4 view;
+
+	// About one texel per pixel across the projected bounding sphere, rounded up to a power
+	// of two so zooming only reallocates when the size on screen doubles or halves
+	GLsizei resolution(const glm::mat4 & model, const CameraBlock & camera, GLuint screenHeight) const {
+		glm::vec3 center = glm::vec3(camera.view * model * glm::vec4(this->center, 1.0f));
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float radius = this->radius * scale;
+		float distance = std::max(-center.z, radius);
+		float pixels = radius / distance * camera.projection[1][1] * (float)screenHeight;
+		GLsizei size = LIGHTING_CACHE_MIN_SIZE;
+		while (size < LIGHTING_CACHE_MAX_SIZE && (float)size < pixels)
+			size *= 2;
+		return size;
+	}
+
+	void allocate() {
+		RenderState::Get().BindTexture(0, GL_TEXTURE_2D, this->texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, this->size, this->size, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_2D, 0);
+		this->texture.SetBytes((GLsizeiptr)this->size * this->size * 4 * sizeof(GLushort));
+		glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::LIGHTING_CACHE::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		this->valid = false;
+	}
+};
\ No newline at end of file
@@ -9,6 +9,11 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include "GpuResource.h"
+#include "VertexLayout.h"
+#include "ImportArena.h"
+#include "AllocationTracker.h"
 #include "Model.h"
 
 using namespace std;
@@ -29,16 +34,24 @@ class FurTexture {
 	const shared_ptr<vector<RGBColor>> _fin;
 
 public:
-	static GLuint fur_textureId;
-	static GLuint fin_textureId;
-	FurTexture(int width, int height, int layers, float density)
-		: _tex(make_shared<vector<RGBColor>>(width * height)), _fin(make_shared<vector<RGBColor>>(width * height))
+	static TextureHandle fur_textureId;
+	static TextureHandle fin_textureId;
+	static int fur_dim;
+	static int fur_layers;
+	static float fur_density;
+	// procedural: the strand mask is hashed in the fragment shader, so only the fin texture is built
+	FurTexture(int width, int height, int layers, float density, bool procedural = false)
+		: _tex(make_shared<vector<RGBColor>>(procedural ? 0 : width * height)), _fin(make_shared<vector<RGBColor>>(width * height))
 	{
+		fur_dim = width;
+		fur_layers = layers;
+		fur_density = density;
 		int totalPixels = width * height;
 		vector<RGBColor> texArray = *_tex;
 		vector<RGBColor> finArray = *_fin;
 		for (int i = 0; i < totalPixels; i++) {
-			texArray[i] = RGBColor();
+			if (!procedural)
+				texArray[i] = RGBColor();
 			finArray[i] = RGBColor();
 		}
 		int numStrands = (int)(density * totalPixels);
@@ -51,7 +64,8 @@ public:
 			int y = rand() % width;
 			float l = (float)(i / strandsPerLayer) / (float)layers;
 			float maxLayer = pow(l, 0.7f);
-			texArray[x * width + y] = RGBColor((unsigned char)(maxLayer * 255), 0, 0, 255);
+			if (!procedural)
+				texArray[x * width + y] = RGBColor((unsigned char)(maxLayer * 255), 0, 0, 255);
 			if (minY < y && y < maxY) {
 				int h = height; // int(height * l);
 				unsigned char r = (unsigned char)((float)(y - minY) * 255 / (float)rangeY);
@@ -59,21 +73,25 @@ public:
 					finArray[x * width + j] = RGBColor(r, 0, 0, 255);
 			}
 		}
-		glGenTextures(1, &fur_textureId);
-		glBindTexture(GL_TEXTURE_2D, fur_textureId);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
-			GL_RGBA, GL_UNSIGNED_BYTE, texArray.data());
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		if (!procedural) {
+			fur_textureId.Create(GPU_FUR);
+			fur_textureId.SetBytes((GLsizeiptr)totalPixels * sizeof(RGBColor));
+			RenderState::Get().BindTexture(0, GL_TEXTURE_2D, fur_textureId);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, texArray.data());
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			RenderState::Get().BindTexture(0, GL_TEXTURE_2D, 0);
+		}
 
-		glGenTextures(1, &fin_textureId);
-		glBindTexture(GL_TEXTURE_2D, fin_textureId);
+		fin_textureId.Create(GPU_FUR);
+		fin_textureId.SetBytes((GLsizeiptr)totalPixels * sizeof(RGBColor));
+		RenderState::Get().BindTexture(0, GL_TEXTURE_2D, fin_textureId);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
 			GL_RGBA, GL_UNSIGNED_BYTE, finArray.data());
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_2D, 0);
 	}
 };
 
@@ -84,12 +102,402 @@ struct Vertex {
 	GLfloat Layer;
 };
 
+typedef VertexLayout<Vertex,
+	VertexAttribute<0, VERTEX_MEMBER(Vertex, Position)>,
+	VertexAttribute<1, VERTEX_MEMBER(Vertex, Normal)>,
+	VertexAttribute<2, VERTEX_MEMBER(Vertex, TexCoords)>,
+	VertexAttribute<3, VERTEX_MEMBER(Vertex, Layer)>> VertexFloatLayout;
+
+// 16-byte Vertex: position as unorm16 against the mesh bounds with the layer as unorm8 in
+// the spare bytes, an octahedral snorm16 normal and half-float UVs. The vertex shaders
+// decode it with positionOffset/positionScale and packedVertices.
+struct PackedVertex {
+	GLushort Position[3];
+	GLubyte Layer;
+	GLubyte Padding;
+	GLshort Normal[2];
+	GLushort TexCoords[2];
+
+	PackedVertex() {}
+	PackedVertex(const Vertex & v, const glm::vec3 & offset, const glm::vec3 & scale) {
+		for (int i = 0; i < 3; ++i) {
+			float t = scale[i] > 0.0f ? (v.Position[i] - offset[i]) / scale[i] : 0.0f;
+			Position[i] = glm::packUnorm1x16(t);
+		}
+		Layer = (GLubyte)glm::round(glm::clamp(v.Layer, 0.0f, 1.0f) * 255.0f);
+		Padding = 0;
+		glm::vec2 n = octahedral(v.Normal);
+		Normal[0] = (GLshort)glm::packSnorm1x16(n.x);
+		Normal[1] = (GLshort)glm::packSnorm1x16(n.y);
+		TexCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+		TexCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+	}
+
+private:
+	static glm::vec2 octahedral(glm::vec3 n) {
+		float sum = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+		if (sum == 0.0f)
+			return glm::vec2(0.0f, 0.0f);
+		n /= sum;
+		glm::vec2 e(n.x, n.y);
+		if (n.z < 0.0f) {
+			e.x = (1.0f - glm::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+			e.y = (1.0f - glm::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return e;
+	}
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// Same locations as VertexFloatLayout, so the vertex shaders take either
+typedef VertexLayout<PackedVertex,
+	VertexAttribute<0, VERTEX_MEMBER(PackedVertex, Position), true>,
+	VertexAttribute<1, VERTEX_MEMBER(PackedVertex, Normal), true>,
+	VertexAttribute<2, VERTEX_MEMBER(PackedVertex, TexCoords), false, GL_HALF_FLOAT>,
+	VertexAttribute<3, VERTEX_MEMBER(PackedVertex, Layer), true>> VertexPackedLayout;
+
+enum VertexFormat {
+	VERTEX_FLOAT,
+	VERTEX_PACKED
+};
+
+// First-fit allocator over element offsets; freed blocks merge with their neighbours
+class RangeAllocator {
+public:
+	// Returns the first element of count free ones, a multiple of align, or -1 when the capacity must grow
+	GLint Allocate(GLuint count, GLuint align = 1) {
+		for (size_t i = 0; i < this->freeBlocks.size(); ++i) {
+			FreeBlock & block = this->freeBlocks[i];
+			GLuint first = (block.first + align - 1) / align * align;
+			GLuint pad = first - block.first;
+			if (block.count < pad + count)
+				continue;
+			GLuint rest = block.count - pad - count;
+			// the padding before an aligned range stays free
+			if (pad > 0) {
+				block.count = pad;
+				if (rest > 0)
+					this->freeBlocks.insert(this->freeBlocks.begin() + i + 1, FreeBlock{ first + count, rest });
+			}
+			else if (rest > 0) {
+				block.first += count;
+				block.count = rest;
+			}
+			else
+				this->freeBlocks.erase(this->freeBlocks.begin() + i);
+			return (GLint)first;
+		}
+		return -1;
+	}
+
+	void Free(GLuint first, GLuint count) {
+		if (count == 0)
+			return;
+		size_t i = 0;
+		while (i < this->freeBlocks.size() && this->freeBlocks[i].first < first)
+			++i;
+		this->freeBlocks.insert(this->freeBlocks.begin() + i, FreeBlock{ first, count });
+		if (i + 1 < this->freeBlocks.size() && first + count == this->freeBlocks[i + 1].first) {
+			this->freeBlocks[i].count += this->freeBlocks[i + 1].count;
+			this->freeBlocks.erase(this->freeBlocks.begin() + i + 1);
+		}
+		if (i > 0 && this->freeBlocks[i - 1].first + this->freeBlocks[i - 1].count == first) {
+			this->freeBlocks[i - 1].count += this->freeBlocks[i].count;
+			this->freeBlocks.erase(this->freeBlocks.begin() + i);
+		}
+	}
+
+	// Adds the elements between the old and the new capacity to the free list
+	void Grow(GLuint capacity) {
+		GLuint old = this->capacity;
+		this->capacity = capacity;
+		this->Free(old, capacity - old);
+	}
+
+	GLuint Capacity() const {
+		return this->capacity;
+	}
+
+	// Smallest capacity that can hold count more elements in one aligned block
+	GLuint Needed(GLuint count, GLuint align = 1) const {
+		count += align - 1;
+		if (!this->freeBlocks.empty()) {
+			const FreeBlock & last = this->freeBlocks.back();
+			if (last.first + last.count == this->capacity)
+				return this->capacity + count - last.count;
+		}
+		return this->capacity + count;
+	}
+
+private:
+	struct FreeBlock {
+		GLuint first;
+		GLuint count;
+	};
+	// sorted by first
+	vector<FreeBlock> freeBlocks;
+	GLuint capacity = 0;
+};
+
+enum ArenaBuffer {
+	ARENA_VERTICES,
+	ARENA_INDICES
+};
+
+// One VAO over a VBO and EBO shared by every Mesh of a VertexFormat. Meshes own ranges in it
+// and draw with a base vertex, so switching meshes needs no VAO change and draws can be batched.
+// The EBO is counted in GLushorts; 32-bit index ranges take two each and start at an even one.
+// Freed ranges are reused; the buffers only grow.
+class VertexArena {
+public:
+	VertexArrayHandle VAO;
+
+	// The first call for a format needs a current context
+	static VertexArena & Get(VertexFormat format) {
+		if (format == VERTEX_PACKED) {
+			static VertexArena packed((VertexPackedLayout()));
+			return packed;
+		}
+		static VertexArena arena((VertexFloatLayout()));
+		return arena;
+	}
+
+	// Copies the elements into the buffer and returns the first element of their range
+	GLuint Add(ArenaBuffer which, const GLvoid * data, GLuint count, GLuint align = 1) {
+		RangeAllocator & allocator = which == ARENA_VERTICES ? this->vertexRanges : this->indexRanges;
+		GLsizeiptr stride = which == ARENA_VERTICES ? this->vertexSize : sizeof(GLushort);
+		BufferHandle & buffer = which == ARENA_VERTICES ? this->VBO : this->EBO;
+		GLint first = allocator.Allocate(count, align);
+		if (first < 0) {
+			GLuint capacity = glm::max(allocator.Capacity() * 2, (GLuint)((1 << 20) / stride));
+			while (capacity < allocator.Needed(count, align))
+				capacity *= 2;
+			this->grow(buffer, which == ARENA_VERTICES ? GPU_VERTEX : GPU_INDEX, allocator.Capacity() * stride, capacity * stride);
+			allocator.Grow(capacity);
+			RenderState::Get().BindVertexArray(this->VAO);
+			if (which == ARENA_VERTICES)
+				this->setupAttributes();
+			else
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+			first = allocator.Allocate(count, align);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, first * stride, count * stride, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return (GLuint)first;
+	}
+
+	void Free(ArenaBuffer which, GLuint first, GLuint count) {
+		(which == ARENA_VERTICES ? this->vertexRanges : this->indexRanges).Free(first, count);
+	}
+
+private:
+	GLsizeiptr vertexSize;
+	void (*setupLayout)();
+	BufferHandle VBO, EBO;
+	RangeAllocator vertexRanges, indexRanges;
+
+	template<class Layout>
+	VertexArena(Layout) {
+		this->vertexSize = Layout::stride;
+		this->setupLayout = &Layout::Setup;
+		this->VAO.Create(GPU_OTHER);
+		this->VBO.Create(GPU_VERTEX);
+		this->EBO.Create(GPU_INDEX);
+	}
+
+	void setupAttributes() {
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		this->setupLayout();
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Replaces buffer with a larger one holding the same bytes.
+	// The copy targets leave the VAO's element buffer binding alone.
+	static void grow(BufferHandle & buffer, GpuCategory category, GLsizeiptr used, GLsizeiptr capacity) {
+		BufferHandle grown;
+		grown.Create(category);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+		if (used > 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		grown.SetBytes(capacity);
+		buffer = std::move(grown);
+	}
+};
+
+// Move-only ownership of a range in a VertexArena, returned to it on destruction
+class ArenaRange {
+public:
+	ArenaRange() {}
+	ArenaRange(VertexArena & arena, ArenaBuffer which, const GLvoid * data, GLuint count, GLuint align = 1)
+		: arena(&arena), which(which), count(count) {
+		if (count > 0)
+			this->first = arena.Add(which, data, count, align);
+	}
+	ArenaRange(ArenaRange && other) : arena(other.arena), which(other.which), first(other.first), count(other.count) {
+		other.count = 0;
+	}
+	ArenaRange & operator=(ArenaRange && other) {
+		if (this != &other) {
+			this->release();
+			this->arena = other.arena;
+			this->which = other.which;
+			this->first = other.first;
+			this->count = other.count;
+			other.count = 0;
+		}
+		return *this;
+	}
+	ArenaRange(const ArenaRange &) = delete;
+	ArenaRange & operator=(const ArenaRange &) = delete;
+	~ArenaRange() {
+		this->release();
+	}
+
+	GLuint First() const {
+		return this->first;
+	}
+
+private:
+	VertexArena * arena = nullptr;
+	ArenaBuffer which = ARENA_VERTICES;
+	GLuint first = 0;
+	GLuint count = 0;
+
+	void release() {
+		if (this->count > 0)
+			this->arena->Free(this->which, this->first, this->count);
+		this->count = 0;
+	}
+};
+
 struct Texture {
 	GLuint id;
 	string type;
 	aiString path;
 };
 
+// Uniform slots of a material in one program; texture i is always bound to unit i
+struct MaterialBinding {
+	GLuint program;
+	vector<GLint> samplers;
+	GLint shininess;
+	GLint fur, proceduralFur, furDim, furLayers, furDensity;
+	GLint packedVertices, positionOffset, positionScale;
+};
+
+// Resolves the material uniforms once per program so drawing does no string work
+class MaterialBindings {
+public:
+	// Binds textures to units 0..n-1 and points the samplers at them
+	const MaterialBinding & Bind(Shader & shader, const vector<Texture> & textures) {
+		const MaterialBinding & binding = this->get(shader, textures);
+		for (GLuint i = 0; i < textures.size(); i++) {
+			RenderState::Get().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+			shader.SetInt(binding.samplers[i], (GLint)i);
+		}
+		shader.SetFloat(binding.shininess, 16.0f);
+		return binding;
+	}
+
+private:
+	// a handful of programs at most, so a linear scan beats hashing
+	vector<MaterialBinding> bindings;
+
+	const MaterialBinding & get(Shader & shader, const vector<Texture> & textures) {
+		for (const MaterialBinding & binding : this->bindings)
+			if (binding.program == shader.Program)
+				return binding;
+		MaterialBinding binding;
+		binding.program = shader.Program;
+		GLuint diffuseNr = 1;
+		GLuint specularNr = 1;
+		for (const Texture & texture : textures) {
+			string number;
+			if (texture.type == "texture_diffuse")
+				number = to_string(diffuseNr++);
+			else if (texture.type == "texture_specular")
+				number = to_string(specularNr++);
+			binding.samplers.push_back(shader.Slot(("material." + texture.type + number).c_str()));
+		}
+		binding.shininess = shader.Slot("material.shininess");
+		binding.fur = shader.Slot("fur");
+		binding.proceduralFur = shader.Slot("proceduralFur");
+		binding.furDim = shader.Slot("furDim");
+		binding.furLayers = shader.Slot("furLayers");
+		binding.furDensity = shader.Slot("furDensity");
+		binding.packedVertices = shader.Slot("packedVertices");
+		binding.positionOffset = shader.Slot("positionOffset");
+		binding.positionScale = shader.Slot("positionScale");
+		this->bindings.push_back(binding);
+		return this->bindings.back();
+	}
+};
+
+// What CPU geometry a model keeps once it is on the GPU
+enum GeometryRetention {
+	// everything, e.g. for a model other models are still built from
+	RETAIN_ALL,
+	// the un-replicated base mesh of fur models, enough to build another fur model from
+	RETAIN_BASE,
+	// nothing; draws only need the counts
+	RETAIN_NONE
+};
+
+class Mesh;
+
+struct DrawItem {
+	Shader * shader;
+	GLuint texture;
+	GLuint vao;
+	Mesh * mesh;
+	bool fins;
+	// record order, the last sort key so equal draws keep their order
+	GLuint order;
+};
+
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Draws recorded in any order and submitted sorted by program, VAO and texture, so that
+// neighbouring draws share state and RenderState drops the repeated binds. Runs of shell
+// draws with the same program and material go out as one multi-draw over the VertexArena.
+// Every item must be drawable with the uniforms current at Submit; Mesh only sets its material.
+class DrawList {
+public:
+	void Clear() {
+		this->items.clear();
+	}
+	void Add(DrawItem item) {
+		item.order = (GLuint)this->items.size();
+		this->items.push_back(item);
+	}
+	void Submit();
+
+private:
+	// cleared but never shrunk, so recording allocates nothing after the first frame
+	vector<DrawItem> items;
+	vector<DrawElementsIndirectCommand> commands;
+	// GL 3.3 fallback arguments for glMultiDrawElementsBaseVertex
+	vector<GLsizei> counts;
+	vector<const GLvoid*> offsets;
+	vector<GLint> baseVertices;
+	BufferHandle indirectBuffer;
+
+	void submitBatch(size_t first, size_t last);
+};
+
 class Mesh {
 public:
 	friend class GraftalModel;
@@ -98,26 +506,39 @@ public:
 	vector<Vertex> finVertices;
 	vector<GLuint> indices;
 	vector<Texture> textures;
+	// format of meshes created from now on
+	static VertexFormat vertex_format;
+	// whether meshes created from now on may draw their shells as restart-separated strips
+	static bool strip_indices;
 
-	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures,
+	// vertices and indices may live in the ImportArena; the mesh keeps its own copies
+	template<class VertexAlloc, class IndexAlloc>
+	Mesh(const vector<Vertex, VertexAlloc> & vertices, const vector<GLuint, IndexAlloc> & indices, vector<Texture> textures,
 		bool _hasFur = false, int _layers = 0, float _maxFurLength = 0, bool _hasFin = false, bool _slice = false) {
+		ImportScope scope;
 		this->hasFur = _hasFur;
+		this->proceduralFur = false;
 		this->hasFin = _hasFin;
 		this->layers = _layers;
 		this->maxFurLength = _maxFurLength;
 		this->textures = textures;
+		this->textureTypes.reserve(textures.size());
+		for (const Texture & texture : textures)
+			this->textureTypes.push_back(textureTypeId(texture.type));
 		this->slice = _slice;
 		if (!hasFur) {
-			this->vertices = vertices;
-			this->indices = indices;
+			this->vertices.assign(vertices.begin(), vertices.end());
+			this->indices.assign(indices.begin(), indices.end());
 		}
 		else {
-			this->indices = indices;
 			int l = (int)indices.size();
 			int d = (int)vertices.size();
-			for (int i = 1; i < layers; ++i)
-				for (int j = 0; j < l; ++j)
-					this->indices.push_back(this->indices[this->indices.size() - l] + d);
+			this->vertices.reserve((size_t)d * layers);
+			if (hasFin)
+				this->finVertices.reserve((size_t)l * 6 * (layers - 1));
+			// every shell is the base list offset by its layer's first vertex, so only the base
+			// list is kept and each layer draws it with its own base vertex
+			this->indices.assign(indices.begin(), indices.end());
 			// float total = (float)(layers - 1);
 			float total = (float)pow(layers - 1, 0.2);
 			for (int i = 0; i < layers; ++i) {
@@ -166,114 +587,281 @@ public:
 			}
 
 		}
+		this->baseVertexCount = hasFur && layers > 0 ? this->vertices.size() / layers : this->vertices.size();
+		this->drawLayers = hasFur && layers > 0 ? layers : 1;
+		this->triangleCount = (GLsizei)(this->indices.size() / 3) * this->drawLayers;
+		this->finVertexCount = (GLsizei)this->finVertices.size();
 		this->setupMesh();
 	}
 
-	void Draw(Shader shader) {
-		GLuint diffuseNr = 1;
-		GLuint specularNr = 1;
-		for (GLuint i = 0; i < this->textures.size(); i++) {
-			glActiveTexture(GL_TEXTURE0 + i);
-			stringstream ss;
-			string number;
-			string name = this->textures[i].type;
-			if (name == "texture_diffuse")
-				ss << diffuseNr++;
-			else if (name == "texture_specular")
-				ss << specularNr++;
-			number = ss.str();
-			glUniform1i(glGetUniformLocation(shader.Program, ("material." + name + number).c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
+	// Frees the CPU copies that are already uploaded; see GeometryRetention
+	void ReleaseGeometry(GeometryRetention retention) {
+		if (retention == RETAIN_ALL)
+			return;
+		if (retention == RETAIN_BASE) {
+			// layer 0 sits at the base surface, so the first shell is the source mesh
+			this->vertices.resize(this->baseVertexCount);
+			this->vertices.shrink_to_fit();
 		}
-		if (hasFur) {
-			int idx = (int)this->textures.size();
-			glActiveTexture(GL_TEXTURE0 + idx);
-			glBindTexture(GL_TEXTURE_2D, FurTexture::fur_textureId);
-			// glBindTexture(GL_TEXTURE_2D, FurTexture::fin_textureId);
-			glUniform1i(glGetUniformLocation(shader.Program, "fur"), idx);
+		else {
+			vector<Vertex>().swap(this->vertices);
+			vector<GLuint>().swap(this->indices);
 		}
+		vector<Vertex>().swap(this->finVertices);
+	}
+
+	GLsizei TriangleCount() const {
+		return this->triangleCount;
+	}
+
+	// Shells with the same mode and index type can share a multi-draw
+	GLenum Mode() const {
+		return this->mode;
+	}
+	GLenum IndexType() const {
+		return this->indexType;
+	}
+
+	// Queues the shell draw and, for meshes with fins, the fin draw
+	void Record(DrawList & list, Shader & shader) {
+		GLuint vao = VertexArena::Get(this->format).VAO;
+		GLuint texture = this->textures.empty() ? 0 : this->textures[0].id;
+		list.Add(DrawItem{ &shader, texture, vao, this, false, 0 });
+		if (hasFin)
+			list.Add(DrawItem{ &shader, FurTexture::fin_textureId, vao, this, true, 0 });
+	}
 
-		glUniform1f(glGetUniformLocation(shader.Program, "material.shininess"), 16.0f);
-		glBindVertexArray(this->VAO);
-		glDrawElements(GL_TRIANGLES, (GLsizei)this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	// Shells go through DrawList::submitBatch; fins are a plain array draw
+	void SubmitFins(Shader & shader) {
+		const MaterialBinding & binding = this->BindMaterial(shader);
+		RenderState::Get().BindVertexArray(VertexArena::Get(this->format).VAO);
+		int idx = (int)this->textures.size();
+		RenderState::Get().BindTexture(idx, GL_TEXTURE_2D, FurTexture::fin_textureId);
+		shader.SetInt(binding.fur, idx);
+		// glDisable(GL_DEPTH_TEST);
+		glDrawArrays(GL_TRIANGLES, (GLint)this->finRange.First(), this->finVertexCount);
+		// glEnable(GL_DEPTH_TEST);
+	}
 
-		if (hasFin) {
-			int idx = (int)this->textures.size();
-			if (hasFur) {
-				glActiveTexture(GL_TEXTURE0 + idx);
-				glBindTexture(GL_TEXTURE_2D, 0);
+	// Binds the textures and sets the material and shell uniforms
+	const MaterialBinding & BindMaterial(Shader & shader) {
+		const MaterialBinding & binding = this->material.Bind(shader, this->textures);
+		shader.SetInt(binding.packedVertices, this->format == VERTEX_PACKED);
+		shader.SetVec3(binding.positionOffset, this->positionOffset);
+		shader.SetVec3(binding.positionScale, this->positionScale);
+		if (hasFur) {
+			shader.SetInt(binding.proceduralFur, proceduralFur);
+			if (proceduralFur) {
+				shader.SetInt(binding.furDim, FurTexture::fur_dim);
+				shader.SetInt(binding.furLayers, FurTexture::fur_layers);
+				shader.SetFloat(binding.furDensity, FurTexture::fur_density);
+			}
+			else {
+				int idx = (int)this->textures.size();
+				RenderState::Get().BindTexture(idx, GL_TEXTURE_2D, FurTexture::fur_textureId);
+				shader.SetInt(binding.fur, idx);
 			}
-			glActiveTexture(GL_TEXTURE0 + idx);
-			glBindTexture(GL_TEXTURE_2D, FurTexture::fin_textureId);
-			glUniform1i(glGetUniformLocation(shader.Program, "fur"), idx);
-			glBindVertexArray(this->finVAO);
-			// glDisable(GL_DEPTH_TEST);
-			glDrawArrays(GL_TRIANGLES, 0, (GLsizei)finVertices.size());
-			// glEnable(GL_DEPTH_TEST);
-			glBindVertexArray(0);
 		}
+		return binding;
+	}
 
-		for (GLuint i = 0; i < this->textures.size(); i++) {
-			glActiveTexture(GL_TEXTURE0 + i);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		if (hasFur) {
-			int idx = (int)this->textures.size();
-			glActiveTexture(GL_TEXTURE0 + idx);
-			glBindTexture(GL_TEXTURE_2D, 0);
+	// True when other's shells can share one multi-draw with this mesh's
+	bool SameMaterial(const Mesh & other) const {
+		if (this->hasFur != other.hasFur || this->proceduralFur != other.proceduralFur
+			|| this->textures.size() != other.textures.size() || this->format != other.format
+			|| this->positionOffset != other.positionOffset || this->positionScale != other.positionScale)
+			return false;
+		for (size_t i = 0; i < this->textures.size(); i++)
+			if (this->textures[i].id != other.textures[i].id || this->textureTypes[i] != other.textureTypes[i])
+				return false;
+		return true;
+	}
+
+	// One command per layer and index chunk, layers in order so the shells still draw inside out
+	void AppendCommands(vector<DrawElementsIndirectCommand> & commands) const {
+		GLuint first = this->indexType == GL_UNSIGNED_SHORT ? this->indexRange.First() : this->indexRange.First() / 2;
+		for (int layer = 0; layer < this->drawLayers; ++layer) {
+			GLint layerVertex = (GLint)(this->vertexRange.First() + layer * this->baseVertexCount);
+			for (const IndexChunk & chunk : this->chunks)
+				commands.push_back(DrawElementsIndirectCommand{ (GLuint)chunk.count, 1, first + chunk.first, layerVertex + chunk.baseVertex, 0 });
 		}
 	}
 
 private:
-	GLuint VAO, VBO, EBO;
-	GLuint finVAO, finVBO;
+	// A run of the base list drawn with its own base vertex, so that its indices fit 16 bits
+	struct IndexChunk {
+		// in indices of the mesh's index type, from the start of indexRange
+		GLuint first;
+		GLsizei count;
+		GLint baseVertex;
+	};
+	vector<IndexChunk> chunks;
+	// counts of the uploaded geometry, valid after ReleaseGeometry
+	int drawLayers;
+	GLsizei triangleCount;
+	GLsizei finVertexCount;
+	size_t baseVertexCount;
+	// ranges in the VertexArena, freed with the mesh
+	ArenaRange vertexRange;
+	ArenaRange indexRange;
+	ArenaRange finRange;
+	VertexFormat format;
+	// GL_TRIANGLES or GL_TRIANGLE_STRIP, over GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices
+	GLenum mode;
+	GLenum indexType;
+	// packed positions decode as positionOffset + position * positionScale
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
 	bool hasFur;
+	bool proceduralFur;
 	int layers;
 	float maxFurLength;
 	bool hasFin;
 	bool slice;
+	MaterialBindings material;
+	// textureTypeId of each texture's type
+	vector<GLuint> textureTypes;
+
+	// Small id per texture type name, so SameMaterial compares integers instead of strings every frame
+	static GLuint textureTypeId(const string & type) {
+		static vector<string> types;
+		auto it = find(types.begin(), types.end(), type);
+		if (it != types.end())
+			return (GLuint)(it - types.begin());
+		types.push_back(type);
+		return (GLuint)types.size() - 1;
+	}
 
 	void setupMesh() {
-		glGenVertexArrays(1, &this->VAO);
-		glGenBuffers(1, &this->VBO);
-		glGenBuffers(1, &this->EBO);
-		glBindVertexArray(this->VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
-		
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Layer));
-
-		glBindVertexArray(0);
-
-		if (hasFin) {
-			glGenVertexArrays(1, &this->finVAO);
-			glGenBuffers(1, &this->finVBO);
-			glBindVertexArray(this->finVAO);
-			glBindBuffer(GL_ARRAY_BUFFER, this->finVBO);
-			glBufferData(GL_ARRAY_BUFFER, this->finVertices.size() * sizeof(Vertex), &this->finVertices[0], GL_STATIC_DRAW);
-
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-			glEnableVertexAttribArray(3);
-			glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Layer));
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
+		this->format = vertex_format;
+		this->positionOffset = glm::vec3(0.0f);
+		this->positionScale = glm::vec3(1.0f);
+		VertexArena & arena = VertexArena::Get(this->format);
+		this->uploadIndices(arena);
+		if (this->format == VERTEX_FLOAT) {
+			this->vertexRange = ArenaRange(arena, ARENA_VERTICES, this->vertices.data(), (GLuint)this->vertices.size());
+			if (hasFin)
+				this->finRange = ArenaRange(arena, ARENA_VERTICES, this->finVertices.data(), (GLuint)this->finVertices.size());
+			return;
+		}
+
+		// bounds of the shells and fins, which already include the fur length
+		if (!this->vertices.empty() || !this->finVertices.empty()) {
+			glm::vec3 lo = !this->vertices.empty() ? this->vertices[0].Position : this->finVertices[0].Position;
+			glm::vec3 hi = lo;
+			for (const auto & v : this->vertices) {
+				lo = glm::min(lo, v.Position);
+				hi = glm::max(hi, v.Position);
+			}
+			for (const auto & v : this->finVertices) {
+				lo = glm::min(lo, v.Position);
+				hi = glm::max(hi, v.Position);
+			}
+			this->positionOffset = lo;
+			this->positionScale = hi - lo;
 		}
+		this->vertexRange = this->uploadPacked(arena, this->vertices);
+		if (hasFin)
+			this->finRange = this->uploadPacked(arena, this->finVertices);
+	}
+
+	// Uploads the base list as chunks of triangles whose indices span fewer vertices than the
+	// 16-bit restart index, each rebased to its lowest vertex, so any mesh size gets 16-bit
+	// indices; only a single triangle spanning more falls back to 32 bits. With strip_indices
+	// set, strips are used when they come out shorter than the lists. Without shared vertices
+	// no two triangles share an edge, so unindexed meshes skip stripifying.
+	void uploadIndices(VertexArena & arena) {
+		bool stripped = strip_indices && this->baseVertexCount < this->indices.size();
+		ScratchVector<GLuint> lists, strips;
+		lists.reserve(this->indices.size());
+		// a strip list is at most 4/3 of the triangle list; regrowing would strand buffers in the arena
+		if (stripped)
+			strips.reserve(this->indices.size() / 3 * 4);
+		ScratchVector<IndexChunk> listChunks, stripChunks;
+		bool wide = false;
+		size_t t = 0;
+		while (t + 2 < this->indices.size()) {
+			GLuint lo = this->indices[t], hi = lo;
+			size_t end = t;
+			for (; end + 2 < this->indices.size(); end += 3) {
+				const GLuint * tri = &this->indices[end];
+				GLuint triLo = glm::min(tri[0], glm::min(tri[1], tri[2]));
+				GLuint triHi = glm::max(tri[0], glm::max(tri[1], tri[2]));
+				if (glm::max(hi, triHi) - glm::min(lo, triLo) >= 0xFFFFu)
+					break;
+				lo = glm::min(lo, triLo);
+				hi = glm::max(hi, triHi);
+			}
+			if (end == t) {
+				wide = true;
+				break;
+			}
+			size_t start = lists.size();
+			for (size_t i = t; i < end; ++i)
+				lists.push_back(this->indices[i] - lo);
+			listChunks.push_back(IndexChunk{ (GLuint)start, (GLsizei)(end - t), (GLint)lo });
+			if (stripped) {
+				start = strips.size();
+				stripify(lists.data() + (lists.size() - (end - t)), end - t, strips);
+				stripChunks.push_back(IndexChunk{ (GLuint)start, (GLsizei)(strips.size() - start), (GLint)lo });
+			}
+			t = end;
+		}
+
+		if (wide) {
+			this->mode = GL_TRIANGLES;
+			this->indexType = GL_UNSIGNED_INT;
+			this->chunks.assign(1, IndexChunk{ 0, (GLsizei)this->indices.size(), 0 });
+			this->indexRange = ArenaRange(arena, ARENA_INDICES, this->indices.data(), (GLuint)this->indices.size() * 2, 2);
+			return;
+		}
+		bool useStrips = stripped && strips.size() < lists.size();
+		const ScratchVector<GLuint> & source = useStrips ? strips : lists;
+		const ScratchVector<IndexChunk> & sourceChunks = useStrips ? stripChunks : listChunks;
+		this->mode = useStrips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+		this->indexType = GL_UNSIGNED_SHORT;
+		this->chunks.assign(sourceChunks.begin(), sourceChunks.end());
+		ScratchVector<GLushort> shorts(source.size());
+		for (size_t i = 0; i < source.size(); ++i)
+			shorts[i] = source[i] == RESTART_INDEX ? (GLushort)0xFFFFu : (GLushort)source[i];
+		this->indexRange = ArenaRange(arena, ARENA_INDICES, shorts.data(), (GLuint)shorts.size());
+	}
+
+	static const GLuint RESTART_INDEX = 0xFFFFFFFFu;
+
+	// Greedy in-order stripifier: a triangle extends the current strip when it shares the
+	// strip's last edge with the winding the strip gives it, otherwise a new strip starts.
+	// Appends the strips of count list indices to strips, keeping the triangle order.
+	static void stripify(const GLuint * triangles, size_t count, ScratchVector<GLuint> & strips) {
+		// triangles in the current strip; odd ones are wound (b, a, c) from the last edge (a, b)
+		size_t run = 0;
+		for (size_t t = 0; t + 2 < count; t += 3) {
+			const GLuint * tri = &triangles[t];
+			if (run > 0) {
+				GLuint a = strips[strips.size() - 2], b = strips.back();
+				if (run % 2 == 1)
+					std::swap(a, b);
+				int r = 0;
+				while (r < 3 && !(tri[r] == a && tri[(r + 1) % 3] == b))
+					++r;
+				if (r < 3) {
+					strips.push_back(tri[(r + 2) % 3]);
+					++run;
+					continue;
+				}
+				strips.push_back(RESTART_INDEX);
+			}
+			strips.insert(strips.end(), tri, tri + 3);
+			run = 1;
+		}
+	}
+
+	ArenaRange uploadPacked(VertexArena & arena, const vector<Vertex> & source) {
+		ScratchVector<PackedVertex> packed;
+		packed.reserve(source.size());
+		for (const auto & v : source)
+			packed.push_back(PackedVertex(v, this->positionOffset, this->positionScale));
+		return ArenaRange(arena, ARENA_VERTICES, packed.data(), (GLuint)packed.size());
 	}
 
 	void appendFin(Vertex v1, Vertex v2, Vertex v2_, Vertex v1_) {
@@ -289,3 +877,74 @@ private:
 		finVertices.push_back(v1);
 	}
 };
+
+inline void DrawList::Submit() {
+	ALLOCATION_SITE("DrawList::Submit");
+	sort(this->items.begin(), this->items.end(), [](const DrawItem & a, const DrawItem & b) {
+		if (a.shader->Program != b.shader->Program)
+			return a.shader->Program < b.shader->Program;
+		if (a.vao != b.vao)
+			return a.vao < b.vao;
+		if (a.fins != b.fins)
+			return b.fins;
+		if (a.texture != b.texture)
+			return a.texture < b.texture;
+		return a.order < b.order;
+	});
+	size_t i = 0;
+	while (i < this->items.size()) {
+		const DrawItem & item = this->items[i];
+		size_t last = i + 1;
+		if (!item.fins)
+			while (last < this->items.size() && this->items[last].shader == item.shader && !this->items[last].fins
+				&& item.mesh->SameMaterial(*this->items[last].mesh) && item.mesh->Mode() == this->items[last].mesh->Mode()
+				&& item.mesh->IndexType() == this->items[last].mesh->IndexType())
+				++last;
+		item.shader->Use();
+		if (item.fins)
+			item.mesh->SubmitFins(*item.shader);
+		else
+			this->submitBatch(i, last);
+		i = last;
+	}
+}
+
+inline void DrawList::submitBatch(size_t first, size_t last) {
+	Shader & shader = *this->items[first].shader;
+	Mesh & mesh = *this->items[first].mesh;
+	mesh.BindMaterial(shader);
+	RenderState::Get().BindVertexArray(this->items[first].vao);
+	RenderState::Get().PrimitiveRestart(mesh.IndexType());
+	this->commands.clear();
+	for (size_t i = first; i < last; ++i)
+		this->items[i].mesh->AppendCommands(this->commands);
+	GLsizei drawCount = (GLsizei)this->commands.size();
+
+	if (GLEW_VERSION_4_3) {
+		GLsizeiptr size = (GLsizeiptr)(this->commands.size() * sizeof(DrawElementsIndirectCommand));
+		if (this->indirectBuffer == 0)
+			this->indirectBuffer.Create(GPU_OTHER);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirectBuffer);
+		if (size > this->indirectBuffer.Bytes()) {
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, size, this->commands.data(), GL_DYNAMIC_DRAW);
+			this->indirectBuffer.SetBytes(size);
+		}
+		else
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, this->commands.data());
+		glMultiDrawElementsIndirect(mesh.Mode(), mesh.IndexType(), (GLvoid*)0, drawCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return;
+	}
+
+	this->counts.clear();
+	this->offsets.clear();
+	this->baseVertices.clear();
+	GLsizeiptr indexSize = mesh.IndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	for (const DrawElementsIndirectCommand & command : this->commands) {
+		this->counts.push_back((GLsizei)command.count);
+		this->offsets.push_back((const GLvoid*)(command.firstIndex * indexSize));
+		this->baseVertices.push_back(command.baseVertex);
+	}
+	glMultiDrawElementsBaseVertex(mesh.Mode(), this->counts.data(), mesh.IndexType(),
+		this->offsets.data(), drawCount, this->baseVertices.data());
+}
\ No newline at end of file
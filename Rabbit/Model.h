@@ -13,17 +13,20 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "Mesh.h"
+#include "VertexLayout.h"
+#include "Parallel.h"
 #include <unordered_map>
 
 using namespace std;
 
-GLint TextureFromFile(const char* path, string directory);
+TextureHandle TextureFromFile(const char* path, string directory);
 
 class Model
 {
 public:
 	Model(const GLchar* path, bool _hasFur = false, int _layers = 0,
 		float _maxFurLength = 0, bool _hasFin = false, bool _slice = false) {
+		ImportScope scope;
 		this->hasFur = _hasFur;
 		this->hasFin = _hasFin;
 		this->layers = _layers;
@@ -33,15 +36,19 @@ public:
 	}
 
 	Model(const Model & model, bool _hasFur, int _layers, float _maxFurLength, bool _slice = false) {
+		ImportScope scope;
 		this->slice = _slice;
+		this->meshes.reserve(model.meshes.size());
 		for (const auto & mesh : model.meshes) {
 			meshes.push_back(Mesh(mesh.vertices, mesh.indices, mesh.textures, _hasFur, _layers, _maxFurLength, false, _slice));
 		}
 	}
 
-	virtual void Draw(Shader shader) {
+	virtual void Draw(Shader & shader) {
+		this->drawList.Clear();
 		for (GLuint i = 0; i < this->meshes.size(); i++)
-			this->meshes[i].Draw(shader);
+			this->meshes[i].Record(this->drawList, shader);
+		this->drawList.Submit();
 	}
 
 	void SetFurTexture(bool hasFur) {
@@ -50,11 +57,27 @@ public:
 			this->meshes[i].hasFur = hasFur;
 	}
 
+	void SetProceduralFur(bool procedural) {
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].proceduralFur = procedural;
+	}
+
+	// Call once every model built from this one exists
+	void ReleaseGeometry(GeometryRetention retention) {
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].ReleaseGeometry(retention);
+	}
+
 protected:
 	friend class GraftalModel;
+	friend class FeedbackCache;
+	friend class LightingCache;
 	vector<Mesh> meshes;
+	DrawList drawList;
 	string directory;
 	vector<Texture> textures_loaded;
+	// owns the GL textures behind textures_loaded
+	vector<TextureHandle> textureHandles;
 	bool hasFur;
 	bool hasFin;
 	int layers;
@@ -83,9 +106,11 @@ protected:
 	}
 
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene) {
-		vector<Vertex> vertices;
-		vector<GLuint> indices;
+		ScratchVector<Vertex> vertices;
+		ScratchVector<GLuint> indices;
 		vector<Texture> textures;
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve((size_t)mesh->mNumFaces * 3);
 
 		for (GLuint i = 0; i < mesh->mNumVertices; i++) {
 			Vertex vertex;
@@ -139,7 +164,8 @@ protected:
 			}
 			if (!skip) {
 				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
+				this->textureHandles.push_back(TextureFromFile(str.C_Str(), this->directory));
+				texture.id = this->textureHandles.back();
 				texture.type = typeName;
 				texture.path = str;
 				textures.push_back(texture);
@@ -151,14 +177,16 @@ protected:
 };
 
 
-GLint TextureFromFile(const char* path, string directory) {
+TextureHandle TextureFromFile(const char* path, string directory) {
 	string filename = string(path);
 	filename = directory + '/' + filename;
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	TextureHandle textureID;
+	textureID.Create(GPU_TEXTURE);
 	int width, height;
 	unsigned char* image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	// drivers store RGB as RGBA; the mip chain adds a third
+	textureID.SetBytes((GLsizeiptr)width * height * 4 * 4 / 3);
+	RenderState::Get().BindTexture(0, GL_TEXTURE_2D, textureID);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
 	glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -166,7 +194,7 @@ GLint TextureFromFile(const char* path, string directory) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	RenderState::Get().BindTexture(0, GL_TEXTURE_2D, 0);
 	SOIL_free_image_data(image);
 	return textureID;
 }
@@ -180,123 +208,340 @@ struct GraftalVertex {
 	GLfloat furLength;
 	GLfloat alpha;
 
-	GraftalVertex() {}
+	GraftalVertex() : furLength(0.0f), alpha(0.0f) {}
 
-	GraftalVertex(const Vertex & t) {
+	GraftalVertex(const Vertex & t) : furLength(0.0f), alpha(0.0f) {
 		Position = t.Position;
 		Normal = t.Normal;
 		TexCoords = t.TexCoords;
 	}
+};
 
-	bool operator<(const GraftalVertex & t) const {
-		if (Position.x - t.Position.x < -EPISON)
-			return true;
-		if (abs(Position.x - t.Position.x) < EPISON) {
-			if (Position.y - t.Position.y < -EPISON)
-				return true;
-			if (abs(Position.y - t.Position.y) < EPISON) {
-				if (Position.z - t.Position.z < -EPISON)
-					return true;
-			}
-		}
-		return false;
+typedef VertexLayout<GraftalVertex,
+	VertexAttribute<0, VERTEX_MEMBER(GraftalVertex, Position)>,
+	VertexAttribute<1, VERTEX_MEMBER(GraftalVertex, Normal)>,
+	VertexAttribute<2, VERTEX_MEMBER(GraftalVertex, TexCoords)>,
+	VertexAttribute<3, VERTEX_MEMBER(GraftalVertex, furLength)>,
+	VertexAttribute<4, VERTEX_MEMBER(GraftalVertex, alpha)>> GraftalVertexLayout;
+
+// Integer grid cell of size EPISON, used as the welding key
+struct GridCell {
+	long long x, y, z;
+
+	GridCell() : x(0), y(0), z(0) {}
+
+	GridCell(const glm::vec3 & p) {
+		x = llround(p.x / EPISON);
+		y = llround(p.y / EPISON);
+		z = llround(p.z / EPISON);
 	}
 
-	bool operator==(const GraftalVertex & t) const {
-		return abs(Position.x - t.Position.x) < EPISON &&
-			abs(Position.y - t.Position.y) < EPISON &&
-			abs(Position.z - t.Position.z) < EPISON;
+	bool operator==(const GridCell & t) const {
+		return x == t.x && y == t.y && z == t.z;
 	}
+};
 
-	void combine(const GraftalVertex & t) {
-		Normal = (Normal + t.Normal) / 2.0f;
-		TexCoords = (TexCoords + t.TexCoords) / 2.0f;
-		furLength = (furLength + t.furLength) / 2.0f;
-		alpha = (alpha + t.alpha) / 2.0f;
+struct GridCellHash {
+	size_t operator()(const GridCell & c) const {
+		unsigned long long h = (unsigned long long)c.x * 73856093ULL;
+		h ^= (unsigned long long)c.y * 19349663ULL;
+		h ^= (unsigned long long)c.z * 83492791ULL;
+		h ^= h >> 29;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 32;
+		return (size_t)h;
 	}
 };
 
+// Normal-direction x position buckets used to pre-cull graftal points
+#define GRAFTAL_NORMAL_GRID 8
+#define GRAFTAL_SPACE_GRID 4
+
+// dot(gNormal, eyeVec) band of lodLevel 1 and 2 in ArtRabbit.geom
+#define GRAFTAL_LOD_LEVELS 2
+const float GRAFTAL_LOD_BANDS[GRAFTAL_LOD_LEVELS][2] = {
+	{ -0.1f, 0.2f },
+	{ 0.4f, 0.6f }
+};
+
+struct GraftalBucket {
+	GLint first;
+	GLsizei count;
+	glm::vec3 axis;
+	float spread;
+	glm::vec3 center;
+	float radius;
+};
+
 class GraftalModel {
 public:
-	GraftalModel(Model & model, float maxFurLength = 0) {
-		vector<GraftalVertex> temp;
-		for (const auto & mesh : model.meshes) {
-			for (const auto & vertex : mesh.vertices) {
-				GraftalVertex t(vertex);
-				t.furLength = rand() * maxFurLength / RAND_MAX;
-				t.alpha = (float)rand() / RAND_MAX;
-				temp.push_back(t);
-			}
-		}
-		sort(temp.begin(), temp.end());
-		GraftalVertex t = temp[0];
-		for (GLuint i = 1; i < temp.size(); ++i) {
-			if (temp[i] == t)
-				t.combine(temp[i]);
-			else {
-				vertices.push_back(t);
-				t = temp[i];
-			}
-		}
-		temp.push_back(t);
+	GraftalModel(Model & model, float maxFurLength = 0, unsigned int seed = 0) {
+		ImportScope scope;
+		ScratchVector<GraftalVertex> temp;
+		size_t total = 0;
+		for (const auto & mesh : model.meshes)
+			total += mesh.vertices.size();
+		temp.reserve(total);
+		for (const auto & mesh : model.meshes)
+			for (const auto & vertex : mesh.vertices)
+				temp.push_back(GraftalVertex(vertex));
+		if (!model.meshes.empty())
+			textures = model.meshes[0].textures;
+		weld(temp);
+		generateAttributes(maxFurLength, seed);
+		buildBuckets();
 		setupVAO();
 	}
 
-	GraftalModel(const GLchar* path, float maxFurLength = 0) {
-		loadModel(path);
-		for (GraftalVertex & vertex : vertices) {
-			vertex.furLength = rand() * maxFurLength / RAND_MAX;
-			vertex.alpha = (float)rand() / RAND_MAX;
-		}
-		sort(vertices.begin(), vertices.end());
-		GraftalVertex t = vertices[0];
-		vector<GraftalVertex> temp;
-		for (GLuint i = 1; i < vertices.size(); ++i) {
-			if (vertices[i] == t)
-				t.combine(vertices[i]);
+	GraftalModel(const GLchar* path, float maxFurLength = 0, unsigned int seed = 0) {
+		ImportScope scope;
+		ScratchVector<GraftalVertex> temp;
+		loadModel(path, temp);
+		weld(temp);
+		generateAttributes(maxFurLength, seed);
+		buildBuckets();
+		setupVAO();
+	}
+
+	// Keeps only the buckets whose points can pass the band test of lodLevel (any level when 0)
+	// for this view; the following Draw calls submit just those ranges
+	void Cull(const glm::vec3 & viewPos, const glm::mat4 & model, int lodLevel = 0) {
+		ALLOCATION_SITE("GraftalModel::Cull");
+		float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		drawFirst.clear();
+		drawCount.clear();
+		for (const auto & bucket : buckets) {
+			glm::vec3 center = glm::vec3(model * glm::vec4(bucket.center, 1.0f));
+			glm::vec3 toEye = viewPos - center;
+			float distance = glm::length(toEye);
+			float radius = bucket.radius * scale;
+			bool visible = true;
+			if (distance > radius) {
+				// angle between the normal cone and the cone of eye directions over the bucket
+				float theta = acos(glm::clamp(glm::dot(bucket.axis, toEye / distance), -1.0f, 1.0f));
+				float spread = bucket.spread + asin(radius / distance) + 0.01f;
+				float maxP = cos(glm::max(theta - spread, 0.0f));
+				float minP = cos(glm::min(theta + spread, 3.14159265f));
+				visible = false;
+				for (int l = 0; l < GRAFTAL_LOD_LEVELS; ++l)
+					if ((lodLevel == 0 || lodLevel == l + 1) && maxP > GRAFTAL_LOD_BANDS[l][0] && minP < GRAFTAL_LOD_BANDS[l][1])
+						visible = true;
+			}
+			if (!visible)
+				continue;
+			if (!drawFirst.empty() && drawFirst.back() + drawCount.back() == bucket.first)
+				drawCount.back() += bucket.count;
 			else {
-				temp.push_back(t);
-				t = vertices[i];
+				drawFirst.push_back(bucket.first);
+				drawCount.push_back(bucket.count);
 			}
 		}
-		temp.push_back(t);
-		vertices = temp;
-		setupVAO();
+		culled = true;
+	}
+
+	// Frees the welded vertices; culling and drawing only need the buckets and the count
+	void ReleaseGeometry() {
+		vector<GraftalVertex>().swap(vertices);
 	}
 
-	void Draw(Shader shader) {
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_POINTS, 0, (GLsizei)vertices.size());
-		glBindVertexArray(0);
+	size_t VertexCount() const {
+		return vertexCount;
+	}
+
+	void Draw(Shader & shader) {
+		RenderState::Get().BindVertexArray(VAO);
+		if (!culled)
+			glDrawArrays(GL_POINTS, 0, (GLsizei)vertexCount);
+		else if (!drawFirst.empty())
+			glMultiDrawArrays(GL_POINTS, drawFirst.data(), drawCount.data(), (GLsizei)drawFirst.size());
 	}
 
 private:
+	friend class GraftalStrokes;
+	friend class GraftalStrands;
 	vector<GraftalVertex> vertices;
+	size_t vertexCount = 0;
+	// material of the source model's first mesh, used by GraftalStrands
+	vector<Texture> textures;
+	vector<GraftalBucket> buckets;
+	vector<GLint> drawFirst;
+	vector<GLsizei> drawCount;
+	bool culled = false;
 	string directory;
-	GLuint VAO;
+	VertexArrayHandle VAO;
+	BufferHandle VBO;
+
+	static int normalBucket(const glm::vec3 & n) {
+		// octahedral projection of the normal onto a square grid
+		glm::vec3 a = glm::abs(n);
+		float l1 = a.x + a.y + a.z;
+		if (l1 <= 0.0f)
+			return 0;
+		float u = n.x / l1, v = n.y / l1;
+		if (n.z < 0.0f) {
+			float pu = (1.0f - abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			float pv = (1.0f - abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+			u = pu;
+			v = pv;
+		}
+		int x = glm::min((int)((u * 0.5f + 0.5f) * GRAFTAL_NORMAL_GRID), GRAFTAL_NORMAL_GRID - 1);
+		int y = glm::min((int)((v * 0.5f + 0.5f) * GRAFTAL_NORMAL_GRID), GRAFTAL_NORMAL_GRID - 1);
+		return y * GRAFTAL_NORMAL_GRID + x;
+	}
+
+	// Reorders the points so that every (normal direction, position) bucket is contiguous
+	// and records a normal cone and bounding sphere per bucket
+	void buildBuckets() {
+		const int spaceBuckets = GRAFTAL_SPACE_GRID * GRAFTAL_SPACE_GRID * GRAFTAL_SPACE_GRID;
+		const int totalBuckets = GRAFTAL_NORMAL_GRID * GRAFTAL_NORMAL_GRID * spaceBuckets;
+		size_t n = vertices.size();
+		buckets.clear();
+		if (n == 0)
+			return;
+		glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+		for (const auto & v : vertices) {
+			lo = glm::min(lo, v.Position);
+			hi = glm::max(hi, v.Position);
+		}
+		glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+
+		ScratchVector<int> key(n);
+		ParallelFor(0, n, [&](size_t i) {
+			glm::vec3 t = (vertices[i].Position - lo) / extent * (float)GRAFTAL_SPACE_GRID;
+			int x = glm::min((int)t.x, GRAFTAL_SPACE_GRID - 1);
+			int y = glm::min((int)t.y, GRAFTAL_SPACE_GRID - 1);
+			int z = glm::min((int)t.z, GRAFTAL_SPACE_GRID - 1);
+			int space = (z * GRAFTAL_SPACE_GRID + y) * GRAFTAL_SPACE_GRID + x;
+			key[i] = normalBucket(vertices[i].Normal) * spaceBuckets + space;
+		});
+
+		// stable counting sort keeps the result independent of the thread count
+		ScratchVector<GLint> offset(totalBuckets + 1, 0);
+		for (size_t i = 0; i < n; ++i)
+			offset[key[i] + 1]++;
+		for (int b = 0; b < totalBuckets; ++b)
+			offset[b + 1] += offset[b];
+		ScratchVector<GraftalVertex> sorted(n);
+		ScratchVector<GLint> next(offset.begin(), offset.end() - 1);
+		for (size_t i = 0; i < n; ++i)
+			sorted[next[key[i]]++] = vertices[i];
+		std::copy(sorted.begin(), sorted.end(), vertices.begin());
+
+		for (int b = 0; b < totalBuckets; ++b) {
+			if (offset[b] == offset[b + 1])
+				continue;
+			GraftalBucket bucket;
+			bucket.first = offset[b];
+			bucket.count = offset[b + 1] - offset[b];
+			glm::vec3 normalSum(0.0f);
+			glm::vec3 bmin = vertices[bucket.first].Position, bmax = bmin;
+			for (GLint i = bucket.first; i < offset[b + 1]; ++i) {
+				normalSum += vertices[i].Normal;
+				bmin = glm::min(bmin, vertices[i].Position);
+				bmax = glm::max(bmax, vertices[i].Position);
+			}
+			bucket.axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f, 0.0f, 1.0f);
+			bucket.center = (bmin + bmax) * 0.5f;
+			bucket.spread = 0.0f;
+			bucket.radius = 0.0f;
+			for (GLint i = bucket.first; i < offset[b + 1]; ++i) {
+				const glm::vec3 & normal = vertices[i].Normal;
+				float len = glm::length(normal);
+				float c = len > 0.0f ? glm::dot(normal / len, bucket.axis) : -1.0f;
+				bucket.spread = glm::max(bucket.spread, acos(glm::clamp(c, -1.0f, 1.0f)));
+				bucket.radius = glm::max(bucket.radius, glm::length(vertices[i].Position - bucket.center));
+			}
+			buckets.push_back(bucket);
+		}
+	}
 	void setupVAO() {
-		GLuint VBO;
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glBindVertexArray(VAO);
+		VAO.Create(GPU_OTHER);
+		VBO.Create(GPU_VERTEX);
+		RenderState::Get().BindVertexArray(VAO);
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GraftalVertex), &vertices[0], GL_STATIC_DRAW);
+		VBO.SetBytes((GLsizeiptr)(vertices.size() * sizeof(GraftalVertex)));
+		vertexCount = vertices.size();
+		GraftalVertexLayout::Setup();
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GraftalVertex), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GraftalVertex), (GLvoid*)offsetof(GraftalVertex, Normal));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GraftalVertex), (GLvoid*)offsetof(GraftalVertex, TexCoords));
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GraftalVertex), (GLvoid*)offsetof(GraftalVertex, furLength));
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(GraftalVertex), (GLvoid*)offsetof(GraftalVertex, alpha));
-
-		glBindVertexArray(0);
+		RenderState::Get().BindVertexArray(0);
 	}
 
-	void loadModel(string path) {
+	// Merges vertices that fall into the same GridCell and averages their attributes.
+	// Every worker owns the cells whose hash maps to it, so the pass needs no locking,
+	// and the output keeps the order of each cell's first vertex.
+	void weld(const ScratchVector<GraftalVertex> & input) {
+		size_t n = input.size();
+		ScratchVector<GridCell> cells(n);
+		ScratchVector<size_t> hashes(n);
+		ParallelFor(0, n, [&](size_t i) {
+			cells[i] = GridCell(input[i].Position);
+			hashes[i] = GridCellHash()(cells[i]);
+		});
+
+		ScratchVector<GLuint> first(n);
+		ScratchVector<GraftalVertex> sum(n);
+		ScratchVector<GLuint> count(n, 0);
+		ParallelWorkers(n, [&](unsigned int worker, unsigned int workers) {
+			unordered_map<GridCell, GLuint, GridCellHash> owner;
+			for (size_t i = 0; i < n; ++i) {
+				if (hashes[i] % workers != worker)
+					continue;
+				GLuint f = owner.emplace(cells[i], (GLuint)i).first->second;
+				first[i] = f;
+				if (count[f]++ == 0) {
+					sum[f] = input[i];
+					continue;
+				}
+				sum[f].Normal += input[i].Normal;
+				sum[f].TexCoords = sum[f].TexCoords + input[i].TexCoords;
+				sum[f].furLength += input[i].furLength;
+				sum[f].alpha += input[i].alpha;
+			}
+		});
+
+		ScratchVector<GLuint> slot(n);
+		GLuint total = 0;
+		for (size_t i = 0; i < n; ++i)
+			if (first[i] == i)
+				slot[i] = total++;
+		vertices.resize(total);
+		ParallelFor(0, n, [&](size_t i) {
+			if (first[i] != i)
+				return;
+			GraftalVertex v = sum[i];
+			float c = (float)count[i];
+			if (glm::length(v.Normal) > 0.0f)
+				v.Normal = glm::normalize(v.Normal);
+			v.TexCoords = v.TexCoords / c;
+			v.furLength /= c;
+			v.alpha /= c;
+			vertices[slot[i]] = v;
+		});
+	}
+
+	// Uniform value in [0, 1) that only depends on the welded cell, the seed and the stream,
+	// so rebuilds are bit-identical regardless of call order or thread count
+	static float cellRandom(const GridCell & cell, unsigned int seed, unsigned int stream) {
+		unsigned long long h = (unsigned long long)GridCellHash()(cell);
+		h ^= ((unsigned long long)seed << 32) | stream;
+		h += 0x9e3779b97f4a7c15ULL;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+		return (float)(h >> 40) / 16777216.0f;
+	}
+
+	void generateAttributes(float maxFurLength, unsigned int seed) {
+		ParallelFor(0, vertices.size(), [&](size_t i) {
+			GridCell cell(vertices[i].Position);
+			vertices[i].furLength = cellRandom(cell, seed, 0) * maxFurLength;
+			vertices[i].alpha = cellRandom(cell, seed, 1);
+		});
+	}
+
+	// Reads every vertex of the file into out, before welding
+	void loadModel(string path, ScratchVector<GraftalVertex> & out) {
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 		if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
@@ -304,20 +549,24 @@ private:
 			return;
 		}
 		this->directory = path.substr(0, path.find_last_of('/'));
-		this->processNode(scene->mRootNode, scene);
+		size_t total = 0;
+		for (GLuint i = 0; i < scene->mNumMeshes; i++)
+			total += scene->mMeshes[i]->mNumVertices;
+		out.reserve(total);
+		this->processNode(scene->mRootNode, scene, out);
 	}
 
-	void processNode(aiNode* node, const aiScene* scene) {
+	void processNode(aiNode* node, const aiScene* scene, ScratchVector<GraftalVertex> & out) {
 		for (GLuint i = 0; i < node->mNumMeshes; i++) {
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			this->processMesh(mesh, scene);
+			this->processMesh(mesh, scene, out);
 		}
 		for (GLuint i = 0; i < node->mNumChildren; i++) {
-			this->processNode(node->mChildren[i], scene);
+			this->processNode(node->mChildren[i], scene, out);
 		}
 	}
 
-	void processMesh(aiMesh* mesh, const aiScene* scene) {
+	void processMesh(aiMesh* mesh, const aiScene* scene, ScratchVector<GraftalVertex> & out) {
 		for (GLuint i = 0; i < mesh->mNumVertices; i++) {
 			GraftalVertex vertex;
 			glm::vec3 vector;
@@ -337,7 +586,7 @@ private:
 			}
 			else
 				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-			vertices.push_back(vertex);
+			out.push_back(vertex);
 		}
 	}
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// Below this many items the helpers run on the calling thread
+const size_t PARALLEL_MIN_ITEMS = 4096;
+
+inline unsigned int WorkerCount() {
+	unsigned int n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// Calls f(worker, workers) once per worker; f must only touch data owned by its worker
+template<class F>
+void ParallelWorkers(size_t items, F f) {
+	unsigned int workers = items < PARALLEL_MIN_ITEMS ? 1 : WorkerCount();
+	if (workers == 1) {
+		f(0u, 1u);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (unsigned int w = 1; w < workers; ++w)
+		threads.push_back(std::thread(f, w, workers));
+	f(0u, workers);
+	for (auto & t : threads)
+		t.join();
+}
+
+// Calls f(i) for every i in [begin, end), in contiguous chunks per worker
+template<class F>
+void ParallelFor(size_t begin, size_t end, F f) {
+	size_t n = end > begin ? end - begin : 0;
+	ParallelWorkers(n, [&](unsigned int worker, unsigned int workers) {
+		size_t chunk = (n + workers - 1) / workers;
+		size_t first = begin + std::min(n, chunk * worker);
+		size_t last = begin + std::min(n, chunk * (worker + 1));
+		for (size_t i = first; i < last; ++i)
+			f(i);
+	});
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Texture targets tracked per unit
+enum RenderTextureTarget {
+	RENDER_TEXTURE_2D = 0,
+	RENDER_TEXTURE_CUBE_MAP = 1,
+	RENDER_TEXTURE_BUFFER = 2,
+	RENDER_TEXTURE_TARGETS = 3
+};
+
+const GLuint RENDER_STATE_UNITS = 16;
+
+// Shadow of the program, VAO, texture and primitive restart state so binding what is already bound is dropped.
+// Every bind in the renderer goes through here; a bind made behind its back needs Invalidate().
+class RenderState {
+public:
+	static RenderState & Get() {
+		static RenderState state;
+		return state;
+	}
+
+	void UseProgram(GLuint program) {
+		if (program == this->program)
+			return;
+		glUseProgram(program);
+		this->program = program;
+	}
+
+	void BindVertexArray(GLuint vao) {
+		if (vao == this->vao)
+			return;
+		glBindVertexArray(vao);
+		this->vao = vao;
+	}
+
+	void BindTexture(GLuint unit, GLenum target, GLuint texture) {
+		int t = targetIndex(target);
+		if (unit < RENDER_STATE_UNITS && t >= 0 && this->textures[unit][t] == texture)
+			return;
+		if (unit != this->activeUnit) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			this->activeUnit = unit;
+		}
+		glBindTexture(target, texture);
+		if (unit < RENDER_STATE_UNITS && t >= 0)
+			this->textures[unit][t] = texture;
+	}
+
+	// Strips end at the largest value of their index type. The 3.3 path has a single restart
+	// index, so it is set before every indexed draw; lists never reach that value either way.
+	void PrimitiveRestart(GLenum indexType) {
+		if (!this->restartEnabled) {
+			glEnable(GLEW_VERSION_4_3 ? GL_PRIMITIVE_RESTART_FIXED_INDEX : GL_PRIMITIVE_RESTART);
+			this->restartEnabled = true;
+			this->restartIndex = 0;
+		}
+		GLuint index = indexType == GL_UNSIGNED_SHORT ? 0xFFFFu : 0xFFFFFFFFu;
+		if (GLEW_VERSION_4_3 || index == this->restartIndex)
+			return;
+		glPrimitiveRestartIndex(index);
+		this->restartIndex = index;
+	}
+
+	// Called when an object is deleted, since GL may hand its name out again
+	void ForgetProgram(GLuint program) {
+		if (program == this->program)
+			this->program = UNKNOWN;
+	}
+	void ForgetVertexArray(GLuint vao) {
+		if (vao == this->vao)
+			this->vao = UNKNOWN;
+	}
+	void ForgetTexture(GLuint texture) {
+		for (GLuint i = 0; i < RENDER_STATE_UNITS; ++i)
+			for (int t = 0; t < RENDER_TEXTURE_TARGETS; ++t)
+				if (this->textures[i][t] == texture)
+					this->textures[i][t] = UNKNOWN;
+	}
+
+	void Invalidate() {
+		this->program = UNKNOWN;
+		this->vao = UNKNOWN;
+		this->activeUnit = UNKNOWN;
+		this->restartEnabled = false;
+		for (GLuint i = 0; i < RENDER_STATE_UNITS; ++i)
+			for (int t = 0; t < RENDER_TEXTURE_TARGETS; ++t)
+				this->textures[i][t] = UNKNOWN;
+	}
+
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	GLuint program;
+	GLuint vao;
+	GLuint activeUnit;
+	bool restartEnabled;
+	GLuint restartIndex;
+	GLuint textures[RENDER_STATE_UNITS][RENDER_TEXTURE_TARGETS];
+
+	RenderState() {
+		this->Invalidate();
+	}
+
+	static int targetIndex(GLenum target) {
+		switch (target) {
+		case GL_TEXTURE_2D: return RENDER_TEXTURE_2D;
+		case GL_TEXTURE_CUBE_MAP: return RENDER_TEXTURE_CUBE_MAP;
+		case GL_TEXTURE_BUFFER: return RENDER_TEXTURE_BUFFER;
+		default: return -1;
+		}
+	}
+};
\ No newline at end of file
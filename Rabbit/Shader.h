@@ -4,96 +4,467 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <utility>
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "RenderState.h"
+#include "GpuResource.h"
 
+// Preprocessor defines as name and value, e.g. { "SPOT_LIGHT", "0" }
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// Binding points of the uniform blocks shared by every program
+enum UniformBlockBinding {
+	CAMERA_BLOCK = 0,
+	TRANSFORM_BLOCK = 1,
+	LIGHTS_BLOCK = 2
+};
+
+// Compilation is only submitted by the constructors; with KHR_parallel_shader_compile the
+// driver compiles every program on its own threads while Ready() polls without blocking.
+// Use() and Finish() wait for the program, and Slot() and the setters need one of them first.
+// Sources go through a small preprocessor for #include and injected defines; see preprocess().
 class Shader
 {
 public:
-	GLuint Program;
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const GLchar * geometryPath = nullptr) {
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream geometryFile;
-		vShaderFile.exceptions(std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::badbit);
-		geometryFile.exceptions(std::ifstream::badbit);
-		try {
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			if (geometryPath != nullptr)
-				geometryFile.open(geometryPath);
-			std::stringstream vShaderStream, fShaderStream, geometryStream;
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			if (geometryPath != nullptr) {
-				geometryStream << geometryFile.rdbuf();
-				geometryFile.close();
-				geometryCode = geometryStream.str();
-			}
-			vShaderFile.close();
-			fShaderFile.close();
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+	ProgramHandle Program;
+	// feedbackVaryings: outputs captured interleaved by transform feedback, bound before linking.
+	// defines follow the host defines right after #version.
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const GLchar * geometryPath = nullptr,
+		const std::vector<const GLchar*> & feedbackVaryings = std::vector<const GLchar*>(),
+		const ShaderDefines & defines = ShaderDefines()) {
+		this->vertexPath = vertexPath;
+		this->fragmentPath = fragmentPath;
+		if (geometryPath != nullptr)
+			this->geometryPath = geometryPath;
+		this->feedbackVaryings = feedbackVaryings;
+		this->defines = defines;
+		this->build();
+	}
+	Shader(const GLchar* computePath, const ShaderDefines & defines = ShaderDefines()) {
+		this->computePath = computePath;
+		this->defines = defines;
+		this->build();
+	}
+	~Shader() {
+		// like GLHandle, nothing is released once the context is gone
+		if (!GpuRegistry::Get().Alive())
+			return;
+		for (const Stage & stage : this->stages)
+			glDeleteShader(stage.shader);
+	}
+	// the uniform shadows belong to the program, so a copy would let them go stale
+	Shader(const Shader &) = delete;
+	Shader & operator=(const Shader &) = delete;
+	void Use() {
+		if (this->pending)
+			this->complete();
+		RenderState::Get().UseProgram(this->Program);
+	}
+
+	// True once the program is linked and set up; never blocks when the driver compiles in parallel
+	bool Ready() {
+		if (!this->pending)
+			return true;
+		if (ParallelCompile()) {
+			GLint done = GL_FALSE;
+			glGetProgramiv(this->Program, GL_COMPLETION_STATUS_KHR, &done);
+			if (!done)
+				return false;
 		}
-		catch (std::ifstream::failure e) {
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		this->complete();
+		return true;
+	}
+
+	// Waits for the program
+	void Finish() {
+		if (this->pending)
+			this->complete();
+	}
+
+	static bool ParallelCompile() {
+		return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+	}
+
+	// Lets the driver use as many compiler threads as it likes; call once before creating shaders
+	static void EnableParallelCompile() {
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+		else if (GLEW_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+	}
+
+	// This program compiled with extra defines, e.g. { { "SPOT_LIGHT", "1" } } to fold a branch
+	// a uniform would otherwise decide per pixel; they replace defines of the same name.
+	// Submitted on first use and owned by this shader, or this shader itself when it already
+	// has them. Lookups compare in place and do not allocate, so they are fine per draw.
+	Shader & Variant(const ShaderDefines & extra) {
+		if (std::all_of(extra.begin(), extra.end(), [this](const std::pair<std::string, std::string> & define) {
+			return std::find(this->defines.begin(), this->defines.end(), define) != this->defines.end();
+		}))
+			return *this;
+		for (const auto & variant : this->variants)
+			if (variant.first == extra)
+				return *variant.second;
+		ShaderDefines merged = this->defines;
+		for (const auto & define : extra) {
+			auto it = std::find_if(merged.begin(), merged.end(), [&define](const std::pair<std::string, std::string> & d) {
+				return d.first == define.first;
+			});
+			if (it != merged.end())
+				it->second = define.second;
+			else
+				merged.push_back(define);
 		}
-		const GLchar* vShaderCode = vertexCode.c_str();
-		const GLchar * fShaderCode = fragmentCode.c_str();
-		GLuint vertex, fragment, geometry;
-		GLint success;
-		GLchar infoLog[512];
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		Shader * variant = this->computePath.empty()
+			? new Shader(this->vertexPath.c_str(), this->fragmentPath.c_str(),
+				this->geometryPath.empty() ? nullptr : this->geometryPath.c_str(), this->feedbackVaryings, merged)
+			: new Shader(this->computePath.c_str(), merged);
+		this->variants.emplace_back(extra, std::unique_ptr<Shader>(variant));
+		return *variant;
+	}
+
+	// Host constant seen by every shader created afterwards, so sizes shared with C++ live in one place
+	static void Define(const std::string & name, const std::string & value) {
+		ShaderDefines & defines = hostDefines();
+		for (auto & define : defines)
+			if (define.first == name) {
+				define.second = value;
+				return;
+			}
+		defines.emplace_back(name, value);
+	}
+	static void Define(const std::string & name, long long value) {
+		Define(name, std::to_string(value));
+	}
+
+	// Typed setters for default-block uniforms; the program must be in use.
+	// Inactive names are ignored and values equal to the last one sent are skipped.
+	void SetInt(const GLchar* name, GLint value) { this->SetInt(this->Slot(name), value); }
+	void SetUint(const GLchar* name, GLuint value) { this->SetUint(this->Slot(name), value); }
+	void SetFloat(const GLchar* name, GLfloat value) { this->SetFloat(this->Slot(name), value); }
+	void SetVec2(const GLchar* name, const glm::vec2 & value) { this->SetVec2(this->Slot(name), value); }
+	void SetVec3(const GLchar* name, const glm::vec3 & value) { this->SetVec3(this->Slot(name), value); }
+	void SetMat4(const GLchar* name, const glm::mat4 & value) { this->SetMat4(this->Slot(name), value); }
+
+	// Slot of an active uniform, or -1; resolve once and pass it to the setters to skip the name lookup
+	GLint Slot(const GLchar* name) const {
+		auto it = std::lower_bound(this->uniforms.begin(), this->uniforms.end(), name, [](const ActiveUniform & u, const GLchar* name) {
+			return strcmp(u.name.c_str(), name) < 0;
+		});
+		if (it == this->uniforms.end() || strcmp(it->name.c_str(), name) != 0)
+			return -1;
+		return (GLint)(it - this->uniforms.begin());
+	}
+	void SetInt(GLint slot, GLint value) {
+		if (const ActiveUniform * u = this->changed(slot, &value, sizeof(value)))
+			glUniform1i(u->location, value);
+	}
+	void SetUint(GLint slot, GLuint value) {
+		if (const ActiveUniform * u = this->changed(slot, &value, sizeof(value)))
+			glUniform1ui(u->location, value);
+	}
+	void SetFloat(GLint slot, GLfloat value) {
+		if (const ActiveUniform * u = this->changed(slot, &value, sizeof(value)))
+			glUniform1f(u->location, value);
+	}
+	void SetVec2(GLint slot, const glm::vec2 & value) {
+		if (const ActiveUniform * u = this->changed(slot, glm::value_ptr(value), 2 * sizeof(GLfloat)))
+			glUniform2fv(u->location, 1, glm::value_ptr(value));
+	}
+	void SetVec3(GLint slot, const glm::vec3 & value) {
+		if (const ActiveUniform * u = this->changed(slot, glm::value_ptr(value), 3 * sizeof(GLfloat)))
+			glUniform3fv(u->location, 1, glm::value_ptr(value));
+	}
+	void SetMat4(GLint slot, const glm::mat4 & value) {
+		if (const ActiveUniform * u = this->changed(slot, glm::value_ptr(value), 16 * sizeof(GLfloat)))
+			glUniformMatrix4fv(u->location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+private:
+	struct ActiveUniform {
+		std::string name;
+		GLint location;
+		// last value sent, large enough for a mat4
+		GLfloat value[16];
+	};
+	// sorted by name so lookups are a binary search without building strings; never resized after linking
+	std::vector<ActiveUniform> uniforms;
+
+	void resolveUniforms() {
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> buffer(maxLength + 1);
+		for (GLint i = 0; i < count; ++i) {
+			GLint size;
+			GLenum type;
+			GLsizei length;
+			glGetActiveUniform(this->Program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+			ActiveUniform u;
+			u.name.assign(buffer.data(), length);
+			u.location = glGetUniformLocation(this->Program, u.name.c_str());
+			// block members have no location
+			if (u.location < 0)
+				continue;
+			// arrays are reported as "name[0]"; only their first element is set through here
+			if (u.name.size() > 3 && u.name.compare(u.name.size() - 3, 3, "[0]") == 0)
+				u.name.resize(u.name.size() - 3);
+			// linking zero-initializes every default-block uniform
+			memset(u.value, 0, sizeof(u.value));
+			this->uniforms.push_back(u);
 		}
+		std::sort(this->uniforms.begin(), this->uniforms.end(), [](const ActiveUniform & a, const ActiveUniform & b) {
+			return a.name < b.name;
+		});
+	}
 
-		if (geometryPath != nullptr) {
-			const GLchar * gShaderCode = geometryCode.c_str();
-			geometry = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometry, 1, &gShaderCode, NULL);
-			glCompileShader(geometry);
-			glGetShaderiv(geometry, GL_COMPILE_STATUS, &success);
-			if (!success) {
-				glGetShaderInfoLog(geometry, 512, NULL, infoLog);
-				std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n" << infoLog << std::endl;
+	// Returns the uniform when value differs from its shadow, updating the shadow
+	ActiveUniform * changed(GLint slot, const void * value, size_t size) {
+		if (slot < 0)
+			return nullptr;
+		ActiveUniform & u = this->uniforms[slot];
+		if (memcmp(u.value, value, size) == 0)
+			return nullptr;
+		memcpy(u.value, value, size);
+		return &u;
+	}
+
+	// sources and defines, kept to build variants
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string geometryPath;
+	std::string computePath;
+	std::vector<const GLchar*> feedbackVaryings;
+	ShaderDefines defines;
+	std::vector<std::pair<ShaderDefines, std::unique_ptr<Shader>>> variants;
+
+	static ShaderDefines & hostDefines() {
+		static ShaderDefines defines;
+		return defines;
+	}
+
+	void build() {
+		ShaderDefines defines = hostDefines();
+		defines.insert(defines.end(), this->defines.begin(), this->defines.end());
+		this->Program.Create(GPU_OTHER);
+		if (!this->computePath.empty()) {
+			std::string computeCode = preprocess(this->computePath, defines);
+			this->binaryPath = programBinaryPath(computeCode);
+			if (this->loadBinary()) {
+				this->complete();
+				return;
 			}
+			this->submitStage(GL_COMPUTE_SHADER, "COMPUTE", computeCode);
+			this->submitLink();
+			return;
+		}
+		std::string vertexCode = preprocess(this->vertexPath, defines);
+		std::string fragmentCode = preprocess(this->fragmentPath, defines);
+		std::string geometryCode;
+		if (!this->geometryPath.empty())
+			geometryCode = preprocess(this->geometryPath, defines);
+		std::string key = vertexCode + '\0' + fragmentCode + '\0' + geometryCode;
+		for (const GLchar* varying : this->feedbackVaryings)
+			key += std::string("\0", 1) + varying;
+		this->binaryPath = programBinaryPath(key);
+		if (this->loadBinary()) {
+			this->complete();
+			return;
 		}
+		this->submitStage(GL_VERTEX_SHADER, "VERTEX", vertexCode);
+		if (!this->geometryPath.empty())
+			this->submitStage(GL_GEOMETRY_SHADER, "GEOMETRY", geometryCode);
+		this->submitStage(GL_FRAGMENT_SHADER, "FRAGMENT", fragmentCode);
+		if (!this->feedbackVaryings.empty())
+			glTransformFeedbackVaryings(this->Program, (GLsizei)this->feedbackVaryings.size(), this->feedbackVaryings.data(), GL_INTERLEAVED_ATTRIBS);
+		this->submitLink();
+	}
 
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+	// Source of path with every #include "file" resolved relative to the including file, each
+	// file at most once, and the defines inserted after #version. The #line directives keep
+	// compiler messages on the original lines; source string n is the n-th file read.
+	static std::string preprocess(const std::string & path, const ShaderDefines & defines) {
+		std::string code;
+		std::vector<std::string> files;
+		expand(path, defines, code, files);
+		return code;
+	}
+
+	static void expand(const std::string & path, const ShaderDefines & defines, std::string & code, std::vector<std::string> & files) {
+		std::ifstream file(path);
+		if (!file) {
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return;
 		}
+		int source = (int)files.size();
+		files.push_back(path);
+		if (source > 0)
+			code += "#line 1 " + std::to_string(source) + "\n";
+		std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+		std::string line;
+		for (int number = 1; std::getline(file, line); ++number) {
+			size_t first = line.find_first_not_of(" \t");
+			if (first != std::string::npos && line.compare(first, 8, "#include") == 0) {
+				size_t open = line.find('"', first);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos)
+					std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << number << std::endl;
+				else {
+					std::string included = directory + line.substr(open + 1, close - open - 1);
+					if (std::find(files.begin(), files.end(), included) == files.end())
+						expand(included, defines, code, files);
+				}
+				code += "#line " + std::to_string(number + 1) + " " + std::to_string(source) + "\n";
+				continue;
+			}
+			code += line;
+			code += '\n';
+			if (source == 0 && first != std::string::npos && line.compare(first, 8, "#version") == 0) {
+				for (const auto & define : defines)
+					code += "#define " + define.first + " " + define.second + "\n";
+				code += "#line " + std::to_string(number + 1) + " 0\n";
+			}
+		}
+	}
 
-		this->Program = glCreateProgram();
-		glAttachShader(this->Program, vertex);
-		glAttachShader(this->Program, fragment);
-		if (geometryPath != nullptr)
-			glAttachShader(this->Program, geometry);
+	struct Stage {
+		GLuint shader;
+		const GLchar* name;
+	};
+	// compiled stages still attached to a pending link
+	std::vector<Stage> stages;
+	bool pending = false;
+	// empty when the program came from the binary cache
+	std::string binaryPath;
+
+	// Starts compiling one stage; its status is read in complete()
+	void submitStage(GLenum type, const GLchar* name, const std::string & code) {
+		const GLchar* source = code.c_str();
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		glAttachShader(this->Program, shader);
+		this->stages.push_back(Stage{ shader, name });
+	}
+
+	void submitLink() {
+		if (programBinaries())
+			glProgramParameteri(this->Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(this->Program);
+		this->pending = true;
+	}
+
+	// Reports compile and link errors, stores the binary and sets up blocks and uniforms
+	void complete() {
+		GLint success;
+		GLchar infoLog[512];
+		for (const Stage & stage : this->stages) {
+			glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				glGetShaderInfoLog(stage.shader, 512, NULL, infoLog);
+				std::cout << "ERROR::SHADER::" << stage.name << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+			}
+			glDetachShader(this->Program, stage.shader);
+			glDeleteShader(stage.shader);
+		}
+		this->stages.clear();
+		this->pending = false;
 		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
 		if (!success) {
 			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
-		glDeleteShader(vertex);
-		if (geometryPath != nullptr)
-			glDeleteShader(geometry);
-		glDeleteShader(fragment);
+		else if (!this->binaryPath.empty())
+			this->saveBinary();
+		this->bindBlock("Camera", CAMERA_BLOCK);
+		this->bindBlock("Transform", TRANSFORM_BLOCK);
+		this->bindBlock("Lights", LIGHTS_BLOCK);
+		this->resolveUniforms();
 	}
-	void Use() {
-		glUseProgram(this->Program);
+
+	// Program binaries are only valid for the driver that wrote them, so the cache key
+	// hashes the sources together with the vendor, renderer and version strings
+	static std::string programBinaryPath(const std::string & sources) {
+		unsigned long long hash = 14695981039346656037ULL;
+		auto mix = [&hash](const char * data, size_t size) {
+			for (size_t i = 0; i < size; ++i) {
+				hash ^= (unsigned char)data[i];
+				hash *= 1099511628211ULL;
+			}
+			hash ^= 0xFF;
+			hash *= 1099511628211ULL;
+		};
+		mix(sources.data(), sources.size());
+		const GLenum driver[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : driver) {
+			const char * value = (const char *)glGetString(name);
+			if (value != nullptr)
+				mix(value, strlen(value));
+		}
+		char path[64];
+		snprintf(path, sizeof(path), "Shader/%016llx.bin", hash);
+		return path;
+	}
+
+	static bool programBinaries() {
+		if (!GLEW_ARB_get_program_binary)
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	struct ProgramBinaryHeader {
+		char magic[4];
+		GLenum format;
+		GLint length;
+	};
+
+	// False when there is no usable binary; the caller then compiles from source
+	bool loadBinary() {
+		if (!programBinaries())
+			return false;
+		std::ifstream file(this->binaryPath, std::ios::binary);
+		ProgramBinaryHeader header;
+		if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, "RBPB", 4) != 0 || header.length <= 0)
+			return false;
+		std::vector<char> binary(header.length);
+		if (!file.read(binary.data(), header.length))
+			return false;
+		glProgramBinary(this->Program, header.format, binary.data(), header.length);
+		// drivers reject binaries from other builds; the program then links from source as usual
+		GLint success;
+		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
+		if (success)
+			this->binaryPath.clear();
+		return success != 0;
+	}
+
+	void saveBinary() {
+		if (!programBinaries())
+			return;
+		ProgramBinaryHeader header = { { 'R', 'B', 'P', 'B' }, 0, 0 };
+		glGetProgramiv(this->Program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+		if (header.length <= 0)
+			return;
+		std::vector<char> binary(header.length);
+		glGetProgramBinary(this->Program, header.length, NULL, &header.format, binary.data());
+		std::ofstream file(this->binaryPath, std::ios::binary);
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), header.length);
+	}
+
+	void bindBlock(const GLchar* name, GLuint binding) {
+		GLuint index = glGetUniformBlockIndex(this->Program, name);
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(this->Program, index, binding);
 	}
 };
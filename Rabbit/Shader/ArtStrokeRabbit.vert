@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec4 stroke;
+
+out vec4 fColor;
+
+#include "Camera.glsl"
+
+void main()
+{
+	gl_Position = projection * view * vec4(stroke.xyz, 1.0f);
+	if (stroke.w < 0.0f)
+		fColor = vec4(1.0f, 0.47f, 0.0f, 1.0f);
+	else if (stroke.w < 2.0f)
+		fColor = vec4(0.1f, 0.1f, 0.1f, stroke.w);
+	else
+		fColor = vec4(0.9f, 0.9f, 0.9f, stroke.w - 2.0f);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+// View of the frame, bound to CAMERA_BLOCK
+layout (std140) uniform Camera {
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+};
\ No newline at end of file
@@ -1,38 +1,5 @@
 #version 330 core
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    float shininess;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-
-	vec3 position;
-	vec3 direction;
-	float cutoff;
-	float outCutoff;
-
-	float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-};
-
-#define NR_POINT_LIGHTS 2
+#include "Lights.glsl"
 
 in vec3 fragPosition;
 in vec3 Normal;
@@ -41,107 +8,41 @@ in float fragLayer;
 
 out vec4 color;
 
-uniform float metallic;
-uniform float roughness;
-uniform float ao;
-
 uniform sampler2D fur;
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform bool useSpotLight;
+uniform bool proceduralFur;
+uniform int furDim;
+uniform int furLayers;
+uniform float furDensity;
+
+// Variants built with LIGHTING_CACHE 1 read the base lighting from the cache and only darken it per layer
+#ifndef LIGHTING_CACHE
+#define LIGHTING_CACHE 0
+#endif
+uniform sampler2D lightingCache;
+
+#include "Camera.glsl"
 
 // Function prototypes
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 fresnelSchlick(float cosTheta, vec3 F0);
-float DistributionGGX(vec3 N, vec3 H, float roughness);
-float GeometrySchlickGGX(float NdotV, float roughness);
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness);
+vec4 proceduralFurData(vec2 texCoords);
 
 
-const float PI = 3.14159265359;
+#include "PBR.glsl"
+#include "ShellLighting.glsl"
 
 void main() 
 {
-	vec3 norm = normalize(Normal);
-	vec3 viewDir = normalize(viewPos - fragPosition);
-
-	vec3 albedo = pow(texture(material.texture_diffuse1, TexCoords).rgb, vec3(2.2));
-
-	vec3 Lo = vec3(0.0f);
-	for(int i = 0; i < NR_POINT_LIGHTS; i++) 
-	{
-		vec3 lightDir = normalize(pointLights[i].position - fragPosition);
-		vec3 halfway = normalize(lightDir + viewDir);
-
-		float distance = length(pointLights[i].position - fragPosition);
-		float attenuation = 1.0f / (pointLights[i].constant + pointLights[i].linear * distance + pointLights[i].quadratic * (distance * distance)); 
-		vec3 radiance = pointLights[i].diffuse * attenuation*10; 
-
-		vec3 F0 = vec3(0.04); 
-		F0 = mix(F0, albedo, metallic);
-		//vec3 F = fresnelSchlick(max(dot(halfway, viewDir), 0.0), F0);
-		vec3 F = fresnelSchlick(max(dot(norm, viewDir), 0.0), F0);
-
-		float NDF = DistributionGGX(norm, halfway, roughness);       
-		float G = GeometrySmith(norm, viewDir, lightDir, roughness);
-
-		vec3 numerator = NDF * G * F;
-		float denominator = 4.0 * max(dot(norm, viewDir), 0.0) * max(dot(norm, lightDir), 0.0);
-		vec3 specular = numerator / max(denominator, 0.001);
-
-		vec3 kS = F;
-		vec3 kD = vec3(1.0) - kS;
-  
-		kD *= 1.0 - metallic;
-
-		float NdotL = max(dot(norm, lightDir), 0.0);
-		Lo += (kD * albedo / PI + specular) * radiance * NdotL;
-	}
-
-	float theta = dot(normalize(spotLight.position - fragPosition), normalize(-spotLight.direction));
-	float epsilon = spotLight.cutoff - spotLight.outCutoff;
-	float intensity = clamp((theta - spotLight.outCutoff) / epsilon, 0, 1.0);
-
-	vec3 lightDir = normalize(spotLight.position - fragPosition);
-	vec3 halfway = normalize(lightDir + viewDir);
-
-	float distance = length(spotLight.position - fragPosition);
-	float attenuation = 1.0f / (spotLight.constant + spotLight.linear * distance + spotLight.quadratic * (distance * distance)); 
-	vec3 radiance = spotLight.diffuse * attenuation; 
-
-	vec3 F0 = vec3(0.04); 
-	F0 = mix(F0, albedo, metallic);
-	//vec3 F = fresnelSchlick(max(dot(halfway, viewDir), 0.0), F0);
-	vec3 F = fresnelSchlick(max(dot(norm, viewDir), 0.0), F0);
-
-	float NDF = DistributionGGX(norm, halfway, roughness);       
-	float G = GeometrySmith(norm, viewDir, lightDir, roughness);
-
-	vec3 numerator = NDF * G * F;
-	float denominator = 4.0 * max(dot(norm, viewDir), 0.0) * max(dot(norm, lightDir), 0.0);
-	vec3 specular = numerator / max(denominator, 0.001);
-
-	vec3 kS = F;
-	vec3 kD = vec3(1.0) - kS;
-  
-	kD *= 1.0 - metallic;
-
-	float NdotL = max(dot(norm, lightDir), 0.0);
-	if (useSpotLight)
-		Lo += (kD * albedo / PI + specular) * radiance * NdotL * intensity;
-
-	vec3 ambient = vec3(0.03) * albedo * ao;
-    vec3 result = ambient + Lo;
-	
-    result = result / (result + vec3(1.0));
-    result = pow(result, vec3(1.0/2.2));  
-
+#if LIGHTING_CACHE
+	// rgb is weighted by coverage, so filtering next to texels no triangle wrote keeps the lit color
+	vec4 cached = texture(lightingCache, TexCoords);
+	vec3 result = cached.rgb / max(cached.a, 0.0001);
+#else
+	vec3 result = shellLighting(fragPosition, Normal, TexCoords);
+#endif
 
 	float fakeShadow = mix(0.4, 1.0, fragLayer);
   
-	vec4 furData = texture(fur, TexCoords);
+	vec4 furData = proceduralFur ? proceduralFurData(TexCoords) : texture(fur, TexCoords);
 	vec4 furColor = vec4(result, 1.0f) * fakeShadow;
   
 	float visibility = (fragLayer > furData.r) ? 0.0 : furData.a;
@@ -199,42 +100,34 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 }
 
 
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
-}  
-
-float DistributionGGX(vec3 N, vec3 H, float roughness)
+// Integer hash of a fur cell (lowbias32)
+uint furHash(uvec2 cell)
 {
-    float a      = roughness*roughness;
-    float a2     = a*a;
-    float NdotH  = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-	
-    float num   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-	
-    return num / denom;
-}
-
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float num   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-	
-    return num / denom;
+    uint h = cell.x * 1664525u + cell.y * 1013904223u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
 }
 
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
+// Same distribution as FurTexture: density * dim^2 strands dropped at random texels,
+// so a texel is covered with probability 1 - exp(-density). FurTexture writes the layers
+// in order and the last strand on a texel wins, so a covered texel keeps layer k with
+// P(layer <= k) = (exp(-density * (L - 1 - k) / L) - exp(-density)) / (1 - exp(-density));
+// the layer is drawn by inverting that, and the height is pow(l, 0.7).
+vec4 proceduralFurData(vec2 texCoords)
 {
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2  = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1  = GeometrySchlickGGX(NdotL, roughness);
-	
-    return ggx1 * ggx2;
+    vec2 cell = mod(floor(texCoords * float(furDim)), float(furDim));
+    uint h = furHash(uvec2(cell));
+    float coverage = float(h & 0xffffu) / 65536.0;
+    float empty = exp(-furDensity);
+    if (coverage >= 1.0 - empty)
+        return vec4(0.0);
+    float u = (float(h >> 16) + 0.5) / 65536.0;
+    float layers = float(furLayers);
+    float k = clamp(ceil(layers - 1.0 + layers * log(u * (1.0 - empty) + empty) / furDensity), 0.0, layers - 1.0);
+    float l = k / layers;
+    return vec4(pow(l, 0.7), 0.0, 0.0, 1.0);
 }
\ No newline at end of file
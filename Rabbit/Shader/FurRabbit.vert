@@ -9,20 +9,23 @@ out float fragLayer;
 out vec3 fragPosition;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "Camera.glsl"
+#include "Transform.glsl"
 uniform vec3 displacement;
 
+#include "PackedVertex.glsl"
+
 void main()
 {
+	vec3 vertexPosition = positionOffset + position * positionScale;
+	vec3 vertexNormal = decodeNormal(normal);
 	vec3 layerDisplacement = pow(layer, 3.0) * displacement;
-	vec4 newPos = vec4(position + layerDisplacement, 1.0f);
-    gl_Position = projection * view * model * newPos;
+	vec4 newPos = vec4(vertexPosition + layerDisplacement, 1.0f);
+    gl_Position = mvp * newPos;
     fragPosition = vec3(model * newPos);
     // gl_Position = projection * view * model * vec4(position, 1.0f);
     // fragPosition = vec3(model * vec4(position, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * normal;
+    Normal = normalMatrix * vertexNormal;
     TexCoords = texCoords;
 	fragLayer = layer;
 }
\ No newline at end of file
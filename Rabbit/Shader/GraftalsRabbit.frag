@@ -2,40 +2,7 @@
 
 #define USE_TEXTURE true
 
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    float shininess;
-}; 
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-
-	vec3 position;
-	vec3 direction;
-	float cutoff;
-	float outCutoff;
-
-	float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-};
-
-#define NR_POINT_LIGHTS 2
+#include "Lights.glsl"
 
 in vec3 fNormal;
 in vec3 fFragPosition;
@@ -43,24 +10,12 @@ in vec2 fTexCoords;
 
 out vec4 color;
 
-uniform float metallic;
-uniform float roughness;
-uniform float ao;
-
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform bool useSpotLight;
+#include "Camera.glsl"
 
 // Function prototypes
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 fresnelSchlick(float cosTheta, vec3 F0);
-float DistributionGGX(vec3 N, vec3 H, float roughness);
-float GeometrySchlickGGX(float NdotV, float roughness);
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness);
 
-const float PI = 3.14159265359;
+#include "PBR.glsl"
 
 void main()
 {
@@ -129,7 +84,7 @@ void main()
 	kD *= 1.0 - metallic;
 
 	float NdotL = max(dot(norm, lightDir), 0.0);
-	if (useSpotLight)
+	if (spotLightEnabled)
 		Lo += (kD * albedo / PI + specular) * radiance * NdotL * intensity;
 
 	vec3 ambient = vec3(0.03) * albedo * ao;
@@ -164,44 +119,4 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     diffuse *= attenuation;
     specular *= attenuation;
     return ambient + diffuse + specular;
-}
-
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
-}  
-
-float DistributionGGX(vec3 N, vec3 H, float roughness)
-{
-    float a      = roughness*roughness;
-    float a2     = a*a;
-    float NdotH  = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH*NdotH;
-	
-    float num   = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-	
-    return num / denom;
-}
-
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r*r) / 8.0;
-
-    float num   = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-	
-    return num / denom;
-}
-
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
-{
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2  = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1  = GeometrySchlickGGX(NdotL, roughness);
-	
-    return ggx1 * ggx2;
 }
\ No newline at end of file
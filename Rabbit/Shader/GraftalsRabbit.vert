@@ -7,9 +7,13 @@ out vec3 gPosition;
 out vec2 gTexCoords;
 out vec3 gNormal;
 
+#include "PackedVertex.glsl"
+
 void main()
 {
-	gPosition = position;
-    gNormal = normal;
+	vec3 vertexPosition = positionOffset + position * positionScale;
+	vec3 vertexNormal = decodeNormal(normal);
+	gPosition = vertexPosition;
+    gNormal = vertexNormal;
     gTexCoords = texCoords;
 }
\ No newline at end of file
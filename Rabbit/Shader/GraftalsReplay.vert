@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 fragPosition;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoords;
+layout (location = 3) in vec3 tipPosition;
+layout (location = 4) in vec3 tipNormal;
+
+out vec3 fNormal;
+out vec3 fFragPosition;
+out vec2 fTexCoords;
+
+#include "Camera.glsl"
+
+void main()
+{
+	fNormal = normal;
+	fFragPosition = fragPosition;
+	fTexCoords = texCoords;
+	// same facing test as GraftalsRabbit.geom; all three vertices of a fin share the tip
+	float p = dot(tipNormal, normalize(viewPos - tipPosition));
+	if (p < -0.1)
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+	else
+		gl_Position = projection * view * vec4(fragPosition, 1.0f);
+}
\ No newline at end of file
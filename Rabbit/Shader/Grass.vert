@@ -9,32 +9,35 @@ out float fragLayer;
 out vec3 fragPosition;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "Camera.glsl"
+#include "Transform.glsl"
 uniform vec3 displacement;
 uniform vec3 rabbitPostion;
 
+#include "PackedVertex.glsl"
+
 void main()
 {
+	vec3 vertexPosition = positionOffset + position * positionScale;
+	vec3 vertexNormal = decodeNormal(normal);
 
 	vec4 newPos;
-    vec3 pos = vec3(model * vec4(position, 1.0f));
+    vec3 pos = vec3(model * vec4(vertexPosition, 1.0f));
     if(length(pos - rabbitPostion) < 0.8f){
         float dis = length(pos - rabbitPostion);
         vec3 force = (3.0f - dis) * normalize(pos - rabbitPostion);
-        newPos = vec4(position + force, 1.0f);
+        newPos = vec4(vertexPosition + force, 1.0f);
     }
     else{
         vec3 layerDisplacement = pow(layer, 3.0) * displacement;
-        newPos = vec4(position + layerDisplacement, 1.0f);
+        newPos = vec4(vertexPosition + layerDisplacement, 1.0f);
     }
     
     fragPosition = vec3(model * newPos);
-    gl_Position = projection * view * model * newPos;
+    gl_Position = mvp * newPos;
     // gl_Position = projection * view * model * vec4(position, 1.0f);
     // fragPosition = vec3(model * vec4(position, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * normal;
+    Normal = normalMatrix * vertexNormal;
     TexCoords = texCoords;
 	fragLayer = layer;
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330 core
+#include "Lights.glsl"
+
+in vec3 fragPosition;
+in vec3 Normal;
+in vec2 TexCoords;
+
+out vec4 color;
+
+#include "Camera.glsl"
+#include "PBR.glsl"
+#include "ShellLighting.glsl"
+
+void main()
+{
+	color = vec4(shellLighting(fragPosition, Normal, TexCoords), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoords;
+
+out vec3 fragPosition;
+out vec3 Normal;
+out vec2 TexCoords;
+
+#include "Transform.glsl"
+#include "PackedVertex.glsl"
+
+// Rasterizes the base surface over its UVs, so every texel shades the surface point mapped to it
+void main()
+{
+	vec3 vertexPosition = positionOffset + position * positionScale;
+	gl_Position = vec4(texCoords * 2.0 - 1.0, 0.0, 1.0);
+	fragPosition = vec3(model * vec4(vertexPosition, 1.0f));
+	Normal = normalMatrix * decodeNormal(normal);
+	TexCoords = texCoords;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+// Scene lights, bound to LIGHTS_BLOCK; NR_POINT_LIGHTS is defined by the host
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+	vec3 position;
+	float cutoff;
+	vec3 direction;
+	float outCutoff;
+	vec3 ambient;
+	float constant;
+	vec3 diffuse;
+	float linear;
+	float quadratic;
+};
+
+layout (std140) uniform Lights {
+	PointLight pointLights[NR_POINT_LIGHTS];
+	SpotLight spotLight;
+	bool useSpotLight;
+	float metallic;
+	float roughness;
+	float ao;
+};
+
+uniform Material material;
+
+// Variants built with SPOT_LIGHT 0 or 1 fold the spot light test away
+#ifdef SPOT_LIGHT
+#define spotLightEnabled (SPOT_LIGHT != 0)
+#else
+#define spotLightEnabled useSpotLight
+#endif
\ No newline at end of file
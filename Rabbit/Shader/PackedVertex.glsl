@@ -0,0 +1,14 @@
+// Packed meshes: position is unorm16 against the mesh bounds, normal is octahedral
+uniform bool packedVertices;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeNormal(vec3 n)
+{
+	if (!packedVertices)
+		return n;
+	vec3 d = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if (d.z < 0.0)
+		d.xy = (1.0 - abs(d.yx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(d);
+}
\ No newline at end of file
@@ -2,25 +2,7 @@
 
 #define USE_TEXTURE true
 
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    float shininess;
-}; 
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 2
+#include "Lights.glsl"
 
 in vec3 fragPosition;
 in vec3 Normal;
@@ -28,10 +10,14 @@ in vec2 TexCoords;
 
 out vec4 color;
 
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
+#include "Camera.glsl"
+
+// Variants built with ART_DRAW 0 or 1 drop the uniform and its branch
+#ifdef ART_DRAW
+const int artDraw = ART_DRAW;
+#else
 uniform int artDraw;
+#endif
 
 // Function prototypes
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
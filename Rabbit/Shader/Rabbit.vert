@@ -7,14 +7,17 @@ out vec2 TexCoords;
 out vec3 fragPosition;
 out vec3 Normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "Camera.glsl"
+#include "Transform.glsl"
+
+#include "PackedVertex.glsl"
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
-    fragPosition = vec3(model * vec4(position, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * normal;
+	vec3 vertexPosition = positionOffset + position * positionScale;
+	vec3 vertexNormal = decodeNormal(normal);
+    gl_Position = mvp * vec4(vertexPosition, 1.0f);
+    fragPosition = vec3(model * vec4(vertexPosition, 1.0f));
+    Normal = normalMatrix * vertexNormal;
     TexCoords = texCoords;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+// Lit color of the fur and grass shells, also baked by the lighting cache.
+// Include after Lights.glsl, Camera.glsl and PBR.glsl.
+vec3 shellLighting(vec3 surfacePosition, vec3 surfaceNormal, vec2 surfaceTexCoords)
+{
+	vec3 norm = normalize(surfaceNormal);
+	vec3 viewDir = normalize(viewPos - surfacePosition);
+
+	vec3 albedo = pow(texture(material.texture_diffuse1, surfaceTexCoords).rgb, vec3(2.2));
+
+	vec3 Lo = vec3(0.0f);
+	for(int i = 0; i < NR_POINT_LIGHTS; i++) 
+	{
+		vec3 lightDir = normalize(pointLights[i].position - surfacePosition);
+		vec3 halfway = normalize(lightDir + viewDir);
+
+		float distance = length(pointLights[i].position - surfacePosition);
+		float attenuation = 1.0f / (pointLights[i].constant + pointLights[i].linear * distance + pointLights[i].quadratic * (distance * distance)); 
+		vec3 radiance = pointLights[i].diffuse * attenuation*10; 
+
+		vec3 F0 = vec3(0.04); 
+		F0 = mix(F0, albedo, metallic);
+		//vec3 F = fresnelSchlick(max(dot(halfway, viewDir), 0.0), F0);
+		vec3 F = fresnelSchlick(max(dot(norm, viewDir), 0.0), F0);
+
+		float NDF = DistributionGGX(norm, halfway, roughness);       
+		float G = GeometrySmith(norm, viewDir, lightDir, roughness);
+
+		vec3 numerator = NDF * G * F;
+		float denominator = 4.0 * max(dot(norm, viewDir), 0.0) * max(dot(norm, lightDir), 0.0);
+		vec3 specular = numerator / max(denominator, 0.001);
+
+		vec3 kS = F;
+		vec3 kD = vec3(1.0) - kS;
+  
+		kD *= 1.0 - metallic;
+
+		float NdotL = max(dot(norm, lightDir), 0.0);
+		Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+	}
+
+	float theta = dot(normalize(spotLight.position - surfacePosition), normalize(-spotLight.direction));
+	float epsilon = spotLight.cutoff - spotLight.outCutoff;
+	float intensity = clamp((theta - spotLight.outCutoff) / epsilon, 0, 1.0);
+
+	vec3 lightDir = normalize(spotLight.position - surfacePosition);
+	vec3 halfway = normalize(lightDir + viewDir);
+
+	float distance = length(spotLight.position - surfacePosition);
+	float attenuation = 1.0f / (spotLight.constant + spotLight.linear * distance + spotLight.quadratic * (distance * distance)); 
+	vec3 radiance = spotLight.diffuse * attenuation; 
+
+	vec3 F0 = vec3(0.04); 
+	F0 = mix(F0, albedo, metallic);
+	//vec3 F = fresnelSchlick(max(dot(halfway, viewDir), 0.0), F0);
+	vec3 F = fresnelSchlick(max(dot(norm, viewDir), 0.0), F0);
+
+	float NDF = DistributionGGX(norm, halfway, roughness);       
+	float G = GeometrySmith(norm, viewDir, lightDir, roughness);
+
+	vec3 numerator = NDF * G * F;
+	float denominator = 4.0 * max(dot(norm, viewDir), 0.0) * max(dot(norm, lightDir), 0.0);
+	vec3 specular = numerator / max(denominator, 0.001);
+
+	vec3 kS = F;
+	vec3 kD = vec3(1.0) - kS;
+  
+	kD *= 1.0 - metallic;
+
+	float NdotL = max(dot(norm, lightDir), 0.0);
+	if (spotLightEnabled)
+		Lo += (kD * albedo / PI + specular) * radiance * NdotL * intensity;
+
+	vec3 ambient = vec3(0.03) * albedo * ao;
+    vec3 result = ambient + Lo;
+	
+    result = result / (result + vec3(1.0));
+    result = pow(result, vec3(1.0/2.2));  
+
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+// Per-draw model matrices, bound to TRANSFORM_BLOCK
+layout (std140) uniform Transform {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+};
\ No newline at end of file
@@ -1,23 +1,5 @@
 #version 330 core
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    float shininess;
-}; 
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-    
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 2
+#include "Lights.glsl"
 
 in vec3 fNormal;
 in vec3 fFragPosition;
@@ -27,9 +9,8 @@ in float fFragLayer;
 out vec4 color;
 
 uniform sampler2D fur;
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
+
+#include "Camera.glsl"
 
 // Function prototypes
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
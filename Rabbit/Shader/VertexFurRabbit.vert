@@ -1,14 +1,45 @@
 #version 330 core
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texCoords;
 
-out vec2 gTexCoords;
-out vec3 gNormal;
+// GRAFTAL_FLOATS, the floats per GraftalVertex (position, normal, texCoords, furLength, alpha), comes from the host
+
+out vec3 fNormal;
+out vec3 fFragPosition;
+out vec2 fTexCoords;
+out float fFragLayer;
+
+uniform samplerBuffer graftals;
+uniform int strandLayers;
+#include "Camera.glsl"
+#include "Transform.glsl"
+
+uniform vec3 displacement;
+uniform float furLength;
+
+float fetch(int i) {
+	return texelFetch(graftals, gl_InstanceID * GRAFTAL_FLOATS + i).r;
+}
 
 void main()
 {
-    gl_Position = vec4(position, 1.0f);
-    gNormal = normal;
-    gTexCoords = texCoords;
+	vec3 position = vec3(fetch(0), fetch(1), fetch(2));
+	vec3 normal = vec3(fetch(3), fetch(4), fetch(5));
+	fNormal = normalMatrix * normal;
+	fTexCoords = vec2(fetch(6), fetch(7));
+
+	float layer = float(gl_VertexID) / float(strandLayers - 1);
+	fFragLayer = layer;
+
+	vec3 eyeVec = normalize(viewPos - vec3(model * vec4(position, 1.0f)));
+	if (dot(normal, eyeVec) < -0.1) {
+		// back-facing strand: the whole strip lands outside the clip volume
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+		fFragPosition = vec3(0.0f);
+		return;
+	}
+
+	float layerFurLength = furLength * layer;
+	vec3 layerDisplacement = pow(layer, 3.0) * displacement;
+	vec4 newPos = vec4(position + normal * layerFurLength + layerDisplacement, 1.0f);
+	gl_Position = mvp * newPos;
+	fFragPosition = vec3(model * newPos);
 }
\ No newline at end of file
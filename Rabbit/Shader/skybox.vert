@@ -2,11 +2,10 @@
 layout (location = 0) in vec3 position;
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "Camera.glsl"
 
 void main()
 {
-    gl_Position = projection * view * vec4(position, 1.0);  
+    gl_Position = projection * mat4(mat3(view)) * vec4(position, 1.0);  
     TexCoords = position;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
+#include "VertexLayout.h"
 #include "soil.h"
 #include <iostream>
 #include <vector>
@@ -53,17 +54,20 @@ GLfloat skyboxVertices[] = {
 class Skybox
 {
 private:
-	GLuint mVAO, mVBO;
-	GLuint mTextureID;
+	VertexArrayHandle mVAO;
+	BufferHandle mVBO;
+	TextureHandle mTextureID;
 public:
 	void loadCubemap(vector<const GLchar*> faces) {
-		glGenTextures(1, &mTextureID);
+		mTextureID.Create(GPU_TEXTURE);
+		GLsizeiptr bytes = 0;
 		int width, height;
 		unsigned char* image;
-		glBindTexture(GL_TEXTURE_CUBE_MAP, mTextureID);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_CUBE_MAP, mTextureID);
 		for (GLuint i = 0; i < faces.size(); i++) {
 			image = SOIL_load_image(faces[i], &width, &height, 0, SOIL_LOAD_RGB);
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+			bytes += (GLsizeiptr)width * height * 4;
 			SOIL_free_image_data(image);
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -71,27 +75,26 @@ public:
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+		mTextureID.SetBytes(bytes);
 	}
 	void Bind() {
-		glGenVertexArrays(1, &mVAO);
-		glGenBuffers(1, &mVBO);
-		glBindVertexArray(mVAO);
+		mVAO.Create(GPU_OTHER);
+		mVBO.Create(GPU_VERTEX);
+		RenderState::Get().BindVertexArray(mVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-		glBindVertexArray(0);
+		mVBO.SetBytes(sizeof(skyboxVertices));
+		VertexLayout<glm::vec3, VertexAttribute<0, glm::vec3, 0>>::Setup();
+		RenderState::Get().BindVertexArray(0);
 	}
-	void Draw(Shader shader) {
+	void Draw(Shader & shader) {
 		glDepthMask(GL_FALSE);
-		shader.Use(); 
-		glUniform1i(glGetUniformLocation(shader.Program, "skybox"), 0);
-		glBindVertexArray(mVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, mTextureID);
+		shader.Use();
+		shader.SetInt("skybox", 0);
+		RenderState::Get().BindVertexArray(mVAO);
+		RenderState::Get().BindTexture(0, GL_TEXTURE_CUBE_MAP, mTextureID);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
 		glDepthMask(GL_TRUE);
 	}
 };
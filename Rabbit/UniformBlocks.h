@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstring>
+#include <iostream>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "GpuResource.h"
+
+// std140 mirrors of the Camera and Transform blocks declared in the shaders
+struct CameraBlock {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
+struct TransformBlock {
+	glm::mat4 model;
+	glm::mat4 mvp;
+	glm::vec4 normalMatrix[3];
+};
+
+// Lights block: the light structs are ordered so every vec3 shares a 16-byte slot with a float
+// also defined for the shaders by main.cpp
+#define NR_POINT_LIGHTS 2
+
+struct PointLightBlock {
+	glm::vec3 position;
+	GLfloat constant;
+	glm::vec3 ambient;
+	GLfloat linear;
+	glm::vec3 diffuse;
+	GLfloat quadratic;
+	glm::vec3 specular;
+	GLfloat padding;
+};
+
+struct SpotLightBlock {
+	glm::vec3 position;
+	GLfloat cutoff;
+	glm::vec3 direction;
+	GLfloat outCutoff;
+	glm::vec3 ambient;
+	GLfloat constant;
+	glm::vec3 diffuse;
+	GLfloat linear;
+	GLfloat quadratic;
+	GLfloat padding[3];
+};
+
+struct LightsBlock {
+	PointLightBlock pointLights[NR_POINT_LIGHTS];
+	SpotLightBlock spotLight;
+	GLint useSpotLight;
+	GLfloat metallic;
+	GLfloat roughness;
+	GLfloat ao;
+};
+
+static_assert(sizeof(PointLightBlock) == 64 && sizeof(SpotLightBlock) == 80 && sizeof(LightsBlock) == 224,
+	"LightsBlock must match the std140 layout of the Lights block");
+
+// Long-lived block bound once to its binding point and re-uploaded only when its contents change
+template<class T>
+class UniformBuffer {
+public:
+	void Init(GLuint binding) {
+		this->buffer.Create(GPU_UNIFORM);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		this->buffer.SetBytes(sizeof(T));
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->buffer);
+	}
+
+	// data should be value-initialized so that padding compares equal
+	void Update(const T & data) {
+		if (this->valid && memcmp(&data, &this->shadow, sizeof(T)) == 0)
+			return;
+		this->shadow = data;
+		this->valid = true;
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	BufferHandle buffer;
+	T shadow;
+	bool valid = false;
+};
+
+#define UNIFORM_RING_FRAMES 3
+
+// Stream of per-frame uniform data. Each frame writes into its own third of one buffer,
+// persistently mapped where GL 4.4 / ARB_buffer_storage is available, and a fence keeps
+// the CPU from overwriting a third the GPU may still read.
+class UniformRing {
+public:
+	void Init(GLsizeiptr frameSize = 64 * 1024) {
+		GLint align;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		this->alignment = align;
+		this->frameSize = frameSize;
+		GLsizeiptr total = frameSize * UNIFORM_RING_FRAMES;
+		this->buffer.Create(GPU_UNIFORM);
+		this->buffer.SetBytes(total);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, total, NULL, flags);
+			this->mapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+		}
+		else
+			glBufferData(GL_UNIFORM_BUFFER, total, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void BeginFrame() {
+		this->frame = (this->frame + 1) % UNIFORM_RING_FRAMES;
+		if (this->fences[this->frame]) {
+			glClientWaitSync(this->fences[this->frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(this->fences[this->frame]);
+			this->fences[this->frame] = 0;
+		}
+		this->head = this->frame * this->frameSize;
+	}
+
+	void EndFrame() {
+		this->fences[this->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	template<class T>
+	GLintptr Push(const T & data) {
+		GLintptr frameStart = this->frame * this->frameSize;
+		if (this->head + (GLintptr)sizeof(T) > frameStart + this->frameSize) {
+			std::cout << "ERROR::UNIFORM_RING::FRAME_OVERFLOW" << std::endl;
+			this->head = frameStart;
+		}
+		GLintptr offset = this->head;
+		if (this->mapped != nullptr)
+			memcpy(this->mapped + offset, &data, sizeof(T));
+		else {
+			glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(T), &data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		this->head = offset + (sizeof(T) + this->alignment - 1) / this->alignment * this->alignment;
+		return offset;
+	}
+
+	template<class T>
+	void Bind(GLuint binding, GLintptr offset) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, this->buffer, offset, sizeof(T));
+	}
+
+private:
+	BufferHandle buffer;
+	char * mapped = nullptr;
+	GLsync fences[UNIFORM_RING_FRAMES] = {};
+	GLsizeiptr frameSize = 0;
+	GLintptr alignment = 256;
+	GLintptr head = 0;
+	int frame = 0;
+};
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Component type and count of a vertex member
+template<class T> struct AttributeTraits;
+template<> struct AttributeTraits<GLfloat> { typedef GLfloat Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLint> { typedef GLint Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLuint> { typedef GLuint Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLshort> { typedef GLshort Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLushort> { typedef GLushort Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLbyte> { typedef GLbyte Component; static const GLint count = 1; };
+template<> struct AttributeTraits<GLubyte> { typedef GLubyte Component; static const GLint count = 1; };
+template<> struct AttributeTraits<glm::vec2> { typedef GLfloat Component; static const GLint count = 2; };
+template<> struct AttributeTraits<glm::vec3> { typedef GLfloat Component; static const GLint count = 3; };
+template<> struct AttributeTraits<glm::vec4> { typedef GLfloat Component; static const GLint count = 4; };
+template<class T, size_t N> struct AttributeTraits<T[N]> {
+	typedef typename AttributeTraits<T>::Component Component;
+	static const GLint count = (GLint)N * AttributeTraits<T>::count;
+};
+
+// GL type a component is read as unless the attribute says otherwise
+template<class T> struct ComponentType;
+template<> struct ComponentType<GLfloat> { static const GLenum type = GL_FLOAT; };
+template<> struct ComponentType<GLint> { static const GLenum type = GL_INT; };
+template<> struct ComponentType<GLuint> { static const GLenum type = GL_UNSIGNED_INT; };
+template<> struct ComponentType<GLshort> { static const GLenum type = GL_SHORT; };
+template<> struct ComponentType<GLushort> { static const GLenum type = GL_UNSIGNED_SHORT; };
+template<> struct ComponentType<GLbyte> { static const GLenum type = GL_BYTE; };
+template<> struct ComponentType<GLubyte> { static const GLenum type = GL_UNSIGNED_BYTE; };
+
+constexpr size_t attributeTypeSize(GLenum type) {
+	return type == GL_FLOAT || type == GL_INT || type == GL_UNSIGNED_INT ? 4
+		: type == GL_HALF_FLOAT || type == GL_SHORT || type == GL_UNSIGNED_SHORT ? 2
+		: type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1 : 0;
+}
+
+// Member type and offset for VertexAttribute, e.g. VERTEX_MEMBER(Vertex, Normal)
+#define VERTEX_MEMBER(Vertex, member) decltype(Vertex::member), offsetof(Vertex, member)
+
+// A vertex member fed to an attribute location. Type only reinterprets a component of the
+// same size, e.g. GL_HALF_FLOAT over GLushort; Normalized maps integers to [0, 1] or [-1, 1].
+template<GLuint Location, class Member, size_t Offset, bool Normalized = false,
+	GLenum Type = ComponentType<typename AttributeTraits<Member>::Component>::type>
+struct VertexAttribute {
+	typedef typename AttributeTraits<Member>::Component Component;
+	static const GLuint location = Location;
+	static const size_t offset = Offset;
+	static const size_t size = sizeof(Member);
+	static const GLint count = AttributeTraits<Member>::count;
+
+	static_assert(Location < 16, "attribute location out of range");
+	static_assert(count >= 1 && count <= 4, "an attribute has one to four components");
+	static_assert(attributeTypeSize(Type) == sizeof(Component), "attribute type does not match the member");
+	static_assert(!Normalized || (Type != GL_FLOAT && Type != GL_HALF_FLOAT), "only integer attributes are normalized");
+
+	static void Setup(GLsizei stride) {
+		glEnableVertexAttribArray(Location);
+		glVertexAttribPointer(Location, count, Type, Normalized ? GL_TRUE : GL_FALSE, stride, (GLvoid*)Offset);
+	}
+};
+
+template<class Vertex, class... Attributes>
+struct VertexLayoutCheck {
+	static const bool fits = true;
+	static const GLuint locations = 0;
+	static const bool unique = true;
+};
+template<class Vertex, class Attribute, class... Rest>
+struct VertexLayoutCheck<Vertex, Attribute, Rest...> {
+	typedef VertexLayoutCheck<Vertex, Rest...> Next;
+	static const bool fits = Attribute::offset + Attribute::size <= sizeof(Vertex) && Next::fits;
+	static const GLuint locations = (1u << Attribute::location) | Next::locations;
+	static const bool unique = (Next::locations & (1u << Attribute::location)) == 0 && Next::unique;
+};
+
+// The attributes of one vertex struct, checked at compile time and set up in one call.
+// Setup points them at the buffer bound to GL_ARRAY_BUFFER in the bound VAO.
+template<class Vertex, class... Attributes>
+struct VertexLayout {
+	typedef Vertex VertexType;
+	static const GLsizei stride = sizeof(Vertex);
+
+	static_assert(VertexLayoutCheck<Vertex, Attributes...>::fits, "attribute outside the vertex");
+	static_assert(VertexLayoutCheck<Vertex, Attributes...>::unique, "attribute location used twice");
+
+	static void Setup() {
+		int expand[] = { 0, (Attributes::Setup(stride), 0)... };
+		(void)expand;
+	}
+};
\ No newline at end of file
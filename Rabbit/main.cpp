@@ -10,9 +10,34 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Skybox.h"
+#include "GraftalStrokes.h"
+#include "GraftalStrands.h"
+#include "FeedbackCache.h"
+#include "LightingCache.h"
+#include "UniformBlocks.h"
+#include "AllocationTracker.h"
 
 using namespace std;
 
+#ifdef TRACK_ALLOCATIONS
+void * operator new(size_t bytes) {
+	AllocationTracker::Get().Record(bytes);
+	void * p = malloc(bytes > 0 ? bytes : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+void * operator new[](size_t bytes) {
+	return operator new(bytes);
+}
+void operator delete(void * p) noexcept {
+	free(p);
+}
+void operator delete[](void * p) noexcept {
+	free(p);
+}
+#endif
+
 GLuint screenWidth = 800, screenHeight = 600;
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
@@ -28,21 +53,43 @@ bool firstMouse = true;
 GLfloat deltaTime = 0.0f;
 GLfloat lastFrame = 0.0f;
 
-GLuint FurTexture::fur_textureId = 0;
-GLuint FurTexture::fin_textureId = 0;
+TextureHandle FurTexture::fur_textureId;
+TextureHandle FurTexture::fin_textureId;
+int FurTexture::fur_dim = 0;
+int FurTexture::fur_layers = 0;
+float FurTexture::fur_density = 0.0f;
+VertexFormat Mesh::vertex_format = VERTEX_FLOAT;
+bool Mesh::strip_indices = false;
 const int FUR_DIM = 1024;
 const float FUR_DENSITY = 0.7f;
 const int FUR_LAYERS = 20;
 const float FUR_HEIGHT = 0.03f;
+const int STRAND_LAYERS = 10;
 const int GRASS_LAYERS = 30;
 const float GRASS_HEIGHT = 0.8f;
+const bool PROCEDURAL_FUR = false;
+const bool PACKED_VERTICES = true;
+// strips only pay off once the import joins identical vertices; the meshes here share none
+const bool STRIP_INDICES = false;
+// shade fur and grass once per view into UV space instead of on every shell
+const bool LIGHTING_CACHE = true;
+const unsigned int GRAFTAL_SEED = 0;
 
 enum RabbitType {
 	Bunny, FurBunny, VertexBunny, GraftalBunny, ArtBunny, Dump
 } rabbitType;
 
+// Permutations chosen per draw instead of branching on a uniform in the shader
+const ShaderDefines SPOT_LIGHT_OFF = { { "SPOT_LIGHT", "0" } };
+const ShaderDefines SPOT_LIGHT_ON = { { "SPOT_LIGHT", "1" } };
+const ShaderDefines ART_DRAW_OFF = { { "ART_DRAW", "0" } };
+const ShaderDefines ART_DRAW_ON = { { "ART_DRAW", "1" } };
+const ShaderDefines LIGHTING_CACHE_ON = { { "LIGHTING_CACHE", "1" } };
+
 bool animation = true;
 bool useSpotLight = false;
+bool computeStrokes = true;
+bool lightingCache = LIGHTING_CACHE;
 
 const glm::vec3 pointLightPositions[] = {
 	glm::vec3(2.3f, -1.6f, -3.0f),
@@ -52,76 +99,113 @@ const glm::vec3 pointLightPositions[] = {
 glm::vec3 gravity(0.0f, -FUR_HEIGHT, 0.0f);
 glm::vec3 rabbitPostion(2.0f, 0.0f, 2.0f);
 
-template<class T>
-void shader_draw(Shader shader, GLfloat furHeight, glm::vec3 disp, T & ourModel, glm::mat4 model)
+UniformRing uniformRing;
+CameraBlock cameraBlock;
+glm::mat4 lastModel;
+GLintptr lastTransform = -1;
+UniformBuffer<LightsBlock> lightsBuffer;
+
+// Per-object transform block; consecutive draws with the same model matrix share one slot
+void bind_transform(const glm::mat4 & model)
 {
-	shader.Use();
+	if (lastTransform < 0 || model != lastModel) {
+		TransformBlock block;
+		block.model = model;
+		block.mvp = cameraBlock.projection * cameraBlock.view * model;
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+		for (int i = 0; i < 3; ++i)
+			block.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+		lastTransform = uniformRing.Push(block);
+		lastModel = model;
+	}
+	uniformRing.Bind<TransformBlock>(TRANSFORM_BLOCK, lastTransform);
+}
 
-	glUniform3f(glGetUniformLocation(shader.Program, "displacement"), disp.x, disp.y, disp.z);
-	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-	glm::mat4 view = camera.GetViewMatrix();
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
-	glUniform1f(glGetUniformLocation(shader.Program, "furLength"), furHeight);
-
-	glUniform3f(glGetUniformLocation(shader.Program, "viewPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-	// Point light 1
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[0].position"), pointLightPositions[0].x, pointLightPositions[0].y, pointLightPositions[0].z);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[0].ambient"), 0.5f, 0.5f, 0.5f);
-	//glUniform3f(glGetUniformLocation(shader.Program, "pointLights[0].diffuse"), 1.0f, 1.0f, 1.0f);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[0].diffuse"), 1.0f, 1.0f, 1.0f);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[0].specular"), 1.0f, 1.0f, 1.0f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[0].constant"), 1.0f);
-	// glUniform1f(glGetUniformLocation(shader.Program, "pointLights[0].linear"), 0.009f);
-	// glUniform1f(glGetUniformLocation(shader.Program, "pointLights[0].quadratic"), 0.0032f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[0].linear"), 0.009f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[0].quadratic"), 0.0032f);
-	// Point light 2
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[1].position"), pointLightPositions[1].x, pointLightPositions[1].y, pointLightPositions[1].z);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[1].ambient"), 0.5f, 0.5f, 0.5f);
-	//glUniform3f(glGetUniformLocation(shader.Program, "pointLights[1].ambient"), 0.5f, 0.5f, 0.5f);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[1].diffuse"), 1.0f, 1.0f, 1.0f);
-	glUniform3f(glGetUniformLocation(shader.Program, "pointLights[1].specular"), 1.0f, 1.0f, 1.0f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[1].constant"), 1.0f);
-	// glUniform1f(glGetUniformLocation(shader.Program, "pointLights[1].linear"), 0.009f);
-	// glUniform1f(glGetUniformLocation(shader.Program, "pointLights[1].quadratic"), 0.0032f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[1].linear"), 0.009f);
-	glUniform1f(glGetUniformLocation(shader.Program, "pointLights[1].quadratic"), 0.0032f);
+// Host constants the shaders size their arrays and outputs with
+void define_shader_constants()
+{
+	Shader::Define("NR_POINT_LIGHTS", NR_POINT_LIGHTS);
+	Shader::Define("GRAFTAL_FLOATS", (long long)(sizeof(GraftalVertex) / sizeof(GLfloat)));
+	Shader::Define("STROKE_LAYERS", STROKE_LAYERS);
+	Shader::Define("STROKE_FILL_VERTICES", STROKE_FILL_VERTICES);
+	Shader::Define("STROKE_OUTLINE_VERTICES", STROKE_OUTLINE_VERTICES);
+	Shader::Define("STROKE_GEOMETRY_VERTICES", STROKE_GEOMETRY_VERTICES);
+	Shader::Define("STROKE_LOCAL_SIZE", STROKE_LOCAL_SIZE);
+}
+
+// Lights and material are shared by every lit shader; the buffer skips the upload when nothing changed
+void update_lights()
+{
+	LightsBlock lights = {};
+	for (int i = 0; i < NR_POINT_LIGHTS; ++i) {
+		PointLightBlock & light = lights.pointLights[i];
+		light.position = pointLightPositions[i];
+		light.ambient = glm::vec3(0.5f);
+		light.diffuse = glm::vec3(1.0f);
+		light.specular = glm::vec3(1.0f);
+		light.constant = 1.0f;
+		light.linear = 0.009f;
+		light.quadratic = 0.0032f;
+	}
 
 	// spot light
-	glUniform1i(glGetUniformLocation(shader.Program, "useSpotLight"), useSpotLight);
-	glUniform3f(glGetUniformLocation(shader.Program, "spotLight.position"), camera.Position.x, camera.Position.y, camera.Position.z);
-	glUniform3f(glGetUniformLocation(shader.Program, "spotLight.direction"), camera.Front.x, camera.Front.y, camera.Front.z);
-	glUniform1f(glGetUniformLocation(shader.Program, "spotLight.cutoff"), glm::cos(glm::radians(0.5f)));
-	glUniform1f(glGetUniformLocation(shader.Program, "spotLight.outCutoff"), glm::cos(glm::radians(1.5f)));
-	glUniform3f(glGetUniformLocation(shader.Program, "spotLight.ambient"), 0.5f, 0.5f, 0.5f);
-	glUniform3f(glGetUniformLocation(shader.Program, "spotLight.diffuse"), 0.0f, 10.0f, 100.0f);
-	glUniform1f(glGetUniformLocation(shader.Program, "spotLight.constant"), 1.0f);
-	glUniform1f(glGetUniformLocation(shader.Program, "spotLight.linear"), 0.009f);
-	glUniform1f(glGetUniformLocation(shader.Program, "spotLight.quadratic"), 0.0032f);
-
-
-	glUniform1f(glGetUniformLocation(shader.Program, "metallic"), 0.5f);
-	glUniform1f(glGetUniformLocation(shader.Program, "roughness"), 0.5f);
-	glUniform1f(glGetUniformLocation(shader.Program, "ao"), 1.0f);
+	lights.useSpotLight = useSpotLight;
+	lights.spotLight.position = camera.Position;
+	lights.spotLight.direction = camera.Front;
+	lights.spotLight.cutoff = glm::cos(glm::radians(0.5f));
+	lights.spotLight.outCutoff = glm::cos(glm::radians(1.5f));
+	lights.spotLight.ambient = glm::vec3(0.5f);
+	lights.spotLight.diffuse = glm::vec3(0.0f, 10.0f, 100.0f);
+	lights.spotLight.constant = 1.0f;
+	lights.spotLight.linear = 0.009f;
+	lights.spotLight.quadratic = 0.0032f;
+
+	lights.metallic = 0.5f;
+	lights.roughness = 0.5f;
+	lights.ao = 1.0f;
+	lightsBuffer.Update(lights);
+}
+
+template<class T>
+void shader_draw(Shader & shader, GLfloat furHeight, glm::vec3 disp, T & ourModel, glm::mat4 model)
+{
+	shader.Use();
+
+	shader.SetVec3("displacement", disp);
+	shader.SetFloat("furLength", furHeight);
 
 	// glm::mat4 model(1.0f);
 	// model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f));
 	// model = glm::scale(model, glm::vec3(0.005f));
 	// model = glm::scale(model, glm::vec3(10.0f));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	bind_transform(model);
 	ourModel.Draw(shader);
 }
 
+// Reshades cache when its view changed and leaves shell in use, reading it
+void bind_lighting(Shader & shell, Shader & bake, LightingCache & cache, glm::mat4 model)
+{
+	if (cache.Update(bake, model, cameraBlock, screenHeight))
+		shader_draw(bake, 0.0f, glm::vec3(0.0f), cache, model);
+	shell.Use();
+	cache.Bind(shell);
+}
+
 
 int main() {
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
 	GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Rabbit", nullptr, nullptr);
+	if (window == nullptr) {
+		// 3.3 only: the Art strokes fall back to the geometry shader
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(screenWidth, screenHeight, "Rabbit", nullptr, nullptr);
+	}
 	glfwMakeContextCurrent(window);
 
 	glfwSetKeyCallback(window, key_callback);
@@ -134,6 +218,8 @@ int main() {
 	glewInit();
 
 	glViewport(0, 0, screenWidth, screenHeight);
+	uniformRing.Init();
+	lightsBuffer.Init(LIGHTS_BLOCK);
 
 	glEnable(GL_MULTISAMPLE);
 	glEnable(GL_DEPTH_TEST);
@@ -143,23 +229,67 @@ int main() {
 
 	rabbitType = FurBunny;
 
-	FurTexture fur(FUR_DIM, FUR_DIM, FUR_LAYERS, FUR_DENSITY);
+	// submitted before the models load, so drivers with parallel compile finish them meanwhile
+	Shader::EnableParallelCompile();
+	define_shader_constants();
+	Shader shader("Shader/Rabbit.vert", "Shader/Rabbit.frag", nullptr, {}, ART_DRAW_OFF);
+	Shader furShader("Shader/FurRabbit.vert", "Shader/FurRabbit.frag", nullptr, {}, SPOT_LIGHT_OFF);
+	Shader grassShader("Shader/Grass.vert", "Shader/Grass.frag", nullptr, {}, SPOT_LIGHT_OFF);
+	Shader vertexFurShader("Shader/VertexFurRabbit.vert", "Shader/VertexFurRabbit.frag");
+	Shader graftalsShader("Shader/GraftalsRabbit.vert", "Shader/GraftalsRabbit.frag", "Shader/GraftalsRabbit.geom", {}, SPOT_LIGHT_OFF);
+	// the cache is recaptured only when its inputs change, so the spot light stays a uniform here
+	Shader graftalsCaptureShader("Shader/GraftalsRabbit.vert", "Shader/GraftalsRabbit.frag", "Shader/GraftalsRabbit.geom", GRAFTAL_FEEDBACK_VARYINGS);
+	Shader graftalsReplayShader("Shader/GraftalsReplay.vert", "Shader/GraftalsRabbit.frag", nullptr, {}, SPOT_LIGHT_OFF);
+	Shader artShader("Shader/ArtRabbit.vert", "Shader/ArtRabbit.frag", "Shader/ArtRabbit.geom");
+	Shader skyboxShader("Shader/skybox.vert", "Shader/skybox.frag");
+	Shader lightingShader("Shader/LightingCache.vert", "Shader/LightingCache.frag", nullptr, {}, SPOT_LIGHT_OFF);
+	unique_ptr<Shader> strokeComputeShader, strokeShader;
+	if (GLEW_VERSION_4_3) {
+		strokeComputeShader.reset(new Shader("Shader/ArtRabbit.comp"));
+		strokeShader.reset(new Shader("Shader/ArtStrokeRabbit.vert", "Shader/ArtRabbit.frag"));
+	}
+	vector<Shader*> pendingShaders = { &shader, &furShader, &grassShader, &vertexFurShader, &graftalsShader,
+		&graftalsCaptureShader, &graftalsReplayShader, &artShader, &skyboxShader, &lightingShader };
+	// the other permutations compile alongside, so toggling them never stalls a frame
+	pendingShaders.push_back(&shader.Variant(ART_DRAW_ON));
+	for (Shader * lit : { &furShader, &grassShader, &graftalsShader, &graftalsReplayShader, &lightingShader })
+		pendingShaders.push_back(&lit->Variant(SPOT_LIGHT_ON));
+	pendingShaders.push_back(&furShader.Variant(LIGHTING_CACHE_ON));
+	pendingShaders.push_back(&grassShader.Variant(LIGHTING_CACHE_ON));
+	if (strokeComputeShader) {
+		pendingShaders.push_back(strokeComputeShader.get());
+		pendingShaders.push_back(strokeShader.get());
+	}
+
+	FurTexture fur(FUR_DIM, FUR_DIM, FUR_LAYERS, FUR_DENSITY, PROCEDURAL_FUR);
+	Mesh::vertex_format = PACKED_VERTICES ? VERTEX_PACKED : VERTEX_FLOAT;
+	Mesh::strip_indices = STRIP_INDICES;
 
 	Model bunny("Object/bunny/bunny.obj");
-	GraftalModel graftalsBunny(bunny, FUR_HEIGHT);
+	GraftalModel graftalsBunny(bunny, FUR_HEIGHT, GRAFTAL_SEED);
+	GraftalStrands strandsBunny(graftalsBunny, STRAND_LAYERS);
 	Model furBunny(bunny, true, FUR_LAYERS, FUR_HEIGHT);
 
 	Model p("Object/plane/plane.obj");
 	Model panel(p, true, GRASS_LAYERS, GRASS_HEIGHT);
-
-	Shader shader("Shader/Rabbit.vert", "Shader/Rabbit.frag");
-	Shader furShader("Shader/FurRabbit.vert", "Shader/FurRabbit.frag");
-	Shader grassShader("Shader/Grass.vert", "Shader/Grass.frag");
-	Shader vertexFurShader("Shader/VertexFurRabbit.vert", "Shader/VertexFurRabbit.frag", "Shader/VertexFurRabbit.geom");
-	Shader graftalsShader("Shader/GraftalsRabbit.vert", "Shader/GraftalsRabbit.frag", "Shader/GraftalsRabbit.geom");
-	Shader artOutlineShader("Shader/ArtOutlineRabbit.vert", "Shader/ArtOutlineRabbit.frag", "Shader/ArtOutlineRabbit.geom");
-	Shader artShader("Shader/ArtRabbit.vert", "Shader/ArtRabbit.frag", "Shader/ArtRabbit.geom");
-	Shader skyboxShader("Shader/skybox.vert", "Shader/skybox.frag");
+	furBunny.SetProceduralFur(PROCEDURAL_FUR);
+	panel.SetProceduralFur(PROCEDURAL_FUR);
+
+	FeedbackCache graftalsCache(bunny);
+	// one per placement of the shells; the base surfaces are shaded with the shells' model matrices
+	LightingCache bunnyLighting(bunny);
+	LightingCache grassLighting(p);
+	LightingCache panelLighting(p);
+	unique_ptr<GraftalStrokes> graftalStrokes;
+	if (GLEW_VERSION_4_3)
+		graftalStrokes.reset(new GraftalStrokes(graftalsBunny));
+
+	// everything derived from bunny and p is built, and draws only need the uploaded copies
+	bunny.ReleaseGeometry(RETAIN_NONE);
+	p.ReleaseGeometry(RETAIN_NONE);
+	furBunny.ReleaseGeometry(RETAIN_NONE);
+	panel.ReleaseGeometry(RETAIN_NONE);
+	graftalsBunny.ReleaseGeometry();
 
 	Skybox skybox;
 	vector<const GLchar*> faces;
@@ -172,6 +302,9 @@ int main() {
 	skybox.loadCubemap(faces); 
 	skybox.Bind();
 
+	graftalsCaptureShader.Use();
+	graftalsCaptureShader.SetInt("capture", 1);
+
 	// Model lightBulb("Object/lamp/file.obj");
 	while (!glfwWindowShouldClose(window)) {
 		GLfloat currentFrame = (GLfloat)glfwGetTime();
@@ -183,18 +316,37 @@ int main() {
 		glm::vec3 disp = animation ? gravity + furForce : glm::vec3(0.0f, 0.0f, 0.0f);
 		glm::vec3 dispGrass = animation ? grassForce : glm::vec3(0.0f, 0.0f, 0.0f);
 
-		glfwPollEvents();
-		Do_Movement();
+		{
+			ALLOCATION_SITE("input");
+			glfwPollEvents();
+			Do_Movement();
+		}
+		ALLOCATION_SITE("frame");
+
+		// blank frames until every program is linked, so the window stays responsive
+		if (!pendingShaders.empty()) {
+			pendingShaders.erase(remove_if(pendingShaders.begin(), pendingShaders.end(), [](Shader * s) {
+				return s->Ready();
+			}), pendingShaders.end());
+			if (!pendingShaders.empty()) {
+				glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glfwSwapBuffers(window);
+				continue;
+			}
+		}
 
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		uniformRing.BeginFrame();
+		cameraBlock.projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
+		cameraBlock.view = camera.GetViewMatrix();
+		cameraBlock.viewPos = glm::vec4(camera.Position, 1.0f);
+		uniformRing.Bind<CameraBlock>(CAMERA_BLOCK, uniformRing.Push(cameraBlock));
+		lastTransform = -1;
+		update_lights();
 
-		skyboxShader.Use();
-		glm::mat4 view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-		glm::mat4 projection = glm::perspective(camera.Zoom, (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-		glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
 		skybox.Draw(skyboxShader);
 		
 
@@ -202,9 +354,8 @@ int main() {
 		model = glm::translate(model, rabbitPostion);
 		model = glm::translate(model, glm::vec3(0.1f, -0.2f, -0.15f));
 
+		const ShaderDefines & spotLight = useSpotLight ? SPOT_LIGHT_ON : SPOT_LIGHT_OFF;
 		if (rabbitType == Bunny) {
-			shader.Use();
-			glUniform1i(glGetUniformLocation(shader.Program, "artDraw"), 0);
 			shader_draw(shader, FUR_HEIGHT, disp, bunny, model);
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.1f, 0.35f, 0.1f));
@@ -219,55 +370,63 @@ int main() {
 
 		}
 		else if (rabbitType == FurBunny) {
-			furShader.Use();
-			shader_draw(furShader, FUR_HEIGHT, disp, furBunny, model);
+			Shader & fur = furShader.Variant(lightingCache ? LIGHTING_CACHE_ON : spotLight);
+			Shader & grass = grassShader.Variant(lightingCache ? LIGHTING_CACHE_ON : spotLight);
+			Shader & bake = lightingShader.Variant(spotLight);
+			if (lightingCache)
+				bind_lighting(fur, bake, bunnyLighting, model);
+			shader_draw(fur, FUR_HEIGHT, disp, furBunny, model);
 
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.1f, 0.35f, 0.1f));
 			model = glm::rotate(model, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 			model = glm::scale(model, glm::vec3(0.1f));
-			grassShader.Use();
-			glUniform3f(glGetUniformLocation(grassShader.Program, "rabbitPostion"), rabbitPostion.x, rabbitPostion.y, rabbitPostion.z);
-			glUniform3f(glGetUniformLocation(shader.Program, "displacement"), disp.x, disp.y, disp.z);
-			shader_draw(grassShader, GRASS_HEIGHT, dispGrass, panel, model);
+			if (lightingCache)
+				bind_lighting(grass, bake, grassLighting, model);
+			grass.Use();
+			grass.SetVec3("rabbitPostion", rabbitPostion);
+			shader_draw(grass, GRASS_HEIGHT, dispGrass, panel, model);
 
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.1f, 0.34f, 0.1f));
 			model = glm::scale(model, glm::vec3(0.1f));
-			shader_draw(furShader, GRASS_HEIGHT, dispGrass, panel, model);
+			if (lightingCache)
+				bind_lighting(fur, bake, panelLighting, model);
+			shader_draw(fur, GRASS_HEIGHT, dispGrass, panel, model);
 		}
 		else if (rabbitType == VertexBunny) {
-			shader.Use();
-			glUniform1i(glGetUniformLocation(shader.Program, "artDraw"), 0);
 			shader_draw(shader, FUR_HEIGHT, disp, bunny, model);
-			shader_draw(vertexFurShader, FUR_HEIGHT, disp, bunny, model);
+			shader_draw(vertexFurShader, FUR_HEIGHT, disp, strandsBunny, model);
 		}
 		else if (rabbitType == GraftalBunny) {
 			// shader.Use();
-			// glUniform1i(glGetUniformLocation(shader.Program, "artDraw"), 0);
+			// shader.SetInt("artDraw", 0);
 			// shader_draw(shader, currentFrame, bunny);
-			shader_draw(graftalsShader, FUR_HEIGHT, disp, bunny, model);
+			if (animation)
+				shader_draw(graftalsShader.Variant(spotLight), FUR_HEIGHT, disp, bunny, model);
+			else {
+				// static fins: run the geometry shader only when its inputs change
+				if (graftalsCache.Update(disp, model, FUR_HEIGHT))
+					shader_draw(graftalsCaptureShader, FUR_HEIGHT, disp, graftalsCache, model);
+				shader_draw(graftalsReplayShader.Variant(spotLight), FUR_HEIGHT, disp, graftalsCache, model);
+			}
 		}
 		else if (rabbitType == ArtBunny) {
 			float oldY = gravity.y;
 			gravity.y = 0.0f;
-			shader.Use();
-			glUniform1i(glGetUniformLocation(shader.Program, "artDraw"), 1);
-			shader_draw(shader, FUR_HEIGHT, disp, bunny, model);
-
-			artShader.Use();
-			glUniform1i(glGetUniformLocation(artShader.Program, "lodLevel"), 1);
-			artOutlineShader.Use();
-			glUniform1i(glGetUniformLocation(artOutlineShader.Program, "lodLevel"), 1);
-			shader_draw(artShader, FUR_HEIGHT, disp, graftalsBunny, model);
-			shader_draw(artOutlineShader, FUR_HEIGHT, disp, graftalsBunny, model);
-
-			artShader.Use();
-			glUniform1i(glGetUniformLocation(artShader.Program, "lodLevel"), 2);
-			artOutlineShader.Use();
-			glUniform1i(glGetUniformLocation(artOutlineShader.Program, "lodLevel"), 2);
-			shader_draw(artShader, FUR_HEIGHT, disp, graftalsBunny, model);
-			shader_draw(artOutlineShader, FUR_HEIGHT, disp, graftalsBunny, model);
+			shader_draw(shader.Variant(ART_DRAW_ON), FUR_HEIGHT, disp, bunny, model);
+
+			if (computeStrokes && graftalStrokes) {
+				graftalStrokes->Generate(*strokeComputeShader, model, camera.Position, disp);
+				shader_draw(*strokeShader, FUR_HEIGHT, disp, *graftalStrokes, model);
+			}
+			else {
+				artShader.Use();
+				artShader.SetVec2("viewportSize", glm::vec2((float)screenWidth, (float)screenHeight));
+				artShader.SetFloat("outlineWidth", 1.0f);
+				graftalsBunny.Cull(camera.Position, model);
+				shader_draw(artShader, FUR_HEIGHT, disp, graftalsBunny, model);
+			}
 
 			gravity.y = oldY;
 		}
@@ -279,8 +438,12 @@ int main() {
 		// 	shader_draw(shader, currentFrame, lightBulb, model);
 		// }
 
+		uniformRing.EndFrame();
 		glfwSwapBuffers(window);
+		AllocationTracker::Get().EndFrame();
 	}
+	// GL objects still alive are released with the context
+	GpuRegistry::Get().Shutdown();
 	glfwTerminate();
 	return 0;
 }
@@ -316,6 +479,14 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 	if (action == GLFW_RELEASE && key == GLFW_KEY_N)
 		animation = !animation;
+	if (action == GLFW_RELEASE && key == GLFW_KEY_C)
+		computeStrokes = !computeStrokes;
+	if (action == GLFW_RELEASE && key == GLFW_KEY_K)
+		lightingCache = !lightingCache;
+	if (action == GLFW_RELEASE && key == GLFW_KEY_G)
+		GpuRegistry::Get().Report();
+	if (action == GLFW_RELEASE && key == GLFW_KEY_H)
+		AllocationTracker::Get().Report();
 	if (key >= 0 && key < 1024) {
 		if (action == GLFW_PRESS)
 			keys[key] = true;